@@ -0,0 +1,62 @@
+/**
+ * @file AddressFilter.hpp
+ * @brief Skips the checks of callsites selected by module or symbol name.
+ * @version 0.1.0
+ *
+ *
+ */
+
+#pragma once
+#include "Flags.hpp"
+#include <cstddef>
+#include <cstdint>
+
+namespace insane {
+
+/**
+ * @brief Address range [Begin, End) of the instrumented program
+ *
+ */
+struct AddressRange {
+  uintptr_t Begin;
+  uintptr_t End;
+};
+
+// Sorted disjoint ranges whose callsites are not checked, set at
+// initialization only
+inline AddressRange const *SkippedRanges = nullptr;
+inline size_t SkippedRangeCount = 0;
+
+/**
+ * @brief Builds the skipped ranges from the check_only and skip flags
+ *
+ * Patterns are shell wildcards, matched against the path and file name of
+ * every loaded module, and against the function symbols of the others. A
+ * matching module contributes its executable segments, a matching function its
+ * code. Sites outside of the check_only ranges, if any, and sites inside the
+ * skip ranges are not checked.
+ *
+ * Modules loaded afterwards are never filtered.
+ *
+ * @param Flags
+ */
+void ConfigureAddressFilter(RuntimeFlags const &Flags);
+
+// Binary search in the skipped ranges
+bool InSkippedRange(uintptr_t Address);
+
+/**
+ * @brief Whether the checks of the site calling the interface are skipped
+ *
+ * A site always takes the same path through the search, which is predicted
+ * after its first calls
+ *
+ * @param Address Return address of the interface entry
+ */
+inline bool SkippedSite(void const *Address) {
+  if (SkippedRangeCount == 0)
+    return false;
+  return InSkippedRange(reinterpret_cast<uintptr_t>(Address));
+}
+
+} // namespace insane
@@ -10,7 +10,10 @@
 
 #pragma once
 #include "OpaqueShadow.hpp"
+#include "Simd.hpp"
 #include "Utils.hpp"
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <mutex>
 #include <thread>
@@ -39,6 +42,255 @@ enum FCmpOpcode {
   FCmp_ule
 };
 
+/**
+ * @brief Evaluates Opcode on scalars, or on every lane of vectors, for which
+ * a lane mask is returned. Unordered comparisons are also true when either
+ * operand is NaN
+ *
+ * Always inlined, so that vectors never cross the ABI of the kernels'
+ * instruction sets
+ */
+template <FCmpOpcode Opcode, typename T>
+__attribute__((always_inline)) inline auto ApplyFCmp(T a, T b) {
+  // Unordered comparisons negate the opposite ordered comparison
+  constexpr bool IsScalar = std::is_same_v<decltype(a < b), bool>;
+  auto Negate = [](auto Mask) {
+    if constexpr (IsScalar)
+      return not Mask;
+    else
+      return Mask == 0;
+  };
+
+  if constexpr (Opcode == FCmp_oeq)
+    return a == b;
+  else if constexpr (Opcode == FCmp_one && IsScalar)
+    return a < b || a > b;
+  else if constexpr (Opcode == FCmp_one)
+    return (a < b) | (a > b);
+  else if constexpr (Opcode == FCmp_ogt)
+    return a > b;
+  else if constexpr (Opcode == FCmp_oge)
+    return a >= b;
+  else if constexpr (Opcode == FCmp_olt)
+    return a < b;
+  else if constexpr (Opcode == FCmp_ole)
+    return a <= b;
+  else if constexpr (Opcode == FCmp_ueq)
+    return Negate(ApplyFCmp<FCmp_one>(a, b));
+  else if constexpr (Opcode == FCmp_une)
+    return a != b;
+  else if constexpr (Opcode == FCmp_ugt)
+    return Negate(a <= b);
+  else if constexpr (Opcode == FCmp_uge)
+    return Negate(a < b);
+  else if constexpr (Opcode == FCmp_ult)
+    return Negate(a >= b);
+  else {
+    static_assert(Opcode == FCmp_ule, "Unknown predicate");
+    return Negate(a > b);
+  }
+}
+
+/**
+ * @brief Truth value of a comparison, which holds on vectors if it holds on
+ * every lane
+ */
+template <FCmpOpcode Opcode, typename T>
+__attribute__((always_inline)) inline bool ReduceFCmp(T a, T b) {
+  auto Mask = ApplyFCmp<Opcode>(a, b);
+  if constexpr (std::is_same_v<decltype(Mask), bool>)
+    return Mask;
+  else {
+    constexpr size_t Size = sizeof(Mask) / sizeof(Mask[0]);
+    return simd::MoveMask(Mask) == (~uint64_t(0) >> (64 - Size));
+  }
+}
+
+/**
+ * @brief libm functions with a shadow entry point
+ *
+ */
+enum MathOpcode {
+  Math_sqrt,
+  Math_exp,
+  Math_log,
+  Math_sin,
+  Math_cos,
+  Math_pow
+};
+
+/**
+ * @brief Evaluates a libm function on a scalar, or on every lane of a vector
+ *
+ * @param Opcode Function to evaluate
+ * @param x First operand
+ * @param y Second operand, only used by Math_pow
+ */
+template <typename T> T ApplyMath(MathOpcode Opcode, T x, T y = T()) {
+  if constexpr (std::is_floating_point_v<T>) {
+    switch (Opcode) {
+    case Math_sqrt:
+      return std::sqrt(x);
+    case Math_exp:
+      return std::exp(x);
+    case Math_log:
+      return std::log(x);
+    case Math_sin:
+      return std::sin(x);
+    case Math_cos:
+      return std::cos(x);
+    case Math_pow:
+      return std::pow(x, y);
+    }
+    utils::unreachable("Unknown math function");
+  } else {
+    T Res;
+    for (size_t I = 0; I < sizeof(T) / sizeof(x[0]); I++)
+      Res[I] = ApplyMath(Opcode, x[I], y[I]);
+    return Res;
+  }
+}
+
+/**
+ * @brief Evaluates a libm function on Count doubles with the vector libm of
+ * Target. libmvec results are within 4 ulps of the exact result, against 1
+ * for the scalar libm
+ *
+ * @param Opcode Function to evaluate
+ * @param x First operands
+ * @param y Second operands, only read by Math_pow
+ * @param Res Results, may alias x or y
+ */
+template <simd::ISA Target>
+void ApplyMathArray(MathOpcode Opcode, double const *x, double const *y,
+                    double *Res, size_t Count) {
+  using Libm = simd::Libmvec<Target>;
+  constexpr size_t Width = Libm::Width;
+  for (size_t I = 0; I < Count; I += Width) {
+    // The tail is padded with ones, which no function treats as a special case
+    size_t Lanes = std::min(Width, Count - I);
+    double X[Width], Y[Width], Chunk[Width];
+    std::fill_n(X, Width, 1.);
+    std::fill_n(Y, Width, 1.);
+    std::copy_n(x + I, Lanes, X);
+    switch (Opcode) {
+    case Math_sqrt:
+      Libm::Sqrt(X, Chunk);
+      break;
+    case Math_exp:
+      Libm::Exp(X, Chunk);
+      break;
+    case Math_log:
+      Libm::Log(X, Chunk);
+      break;
+    case Math_sin:
+      Libm::Sin(X, Chunk);
+      break;
+    case Math_cos:
+      Libm::Cos(X, Chunk);
+      break;
+    case Math_pow:
+      std::copy_n(y + I, Lanes, Y);
+      Libm::Pow(X, Y, Chunk);
+      break;
+    }
+    std::copy_n(Chunk, Lanes, Res + I);
+  }
+}
+
+// Same as above, with the instruction set selected at initialization
+inline void ApplyMathArray(MathOpcode Opcode, double const *x, double const *y,
+                           double *Res, size_t Count) {
+  switch (simd::GetISA()) {
+  case simd::ISA::AVX512:
+    return ApplyMathArray<simd::ISA::AVX512>(Opcode, x, y, Res, Count);
+  case simd::ISA::AVX2:
+    return ApplyMathArray<simd::ISA::AVX2>(Opcode, x, y, Res, Count);
+  default:
+    return ApplyMathArray<simd::ISA::Generic>(Opcode, x, y, Res, Count);
+  }
+}
+
+/**
+ * @brief Horizontal vector reductions
+ *
+ */
+enum ReduceOpcode { Reduce_fadd, Reduce_fmul, Reduce_fmin, Reduce_fmax };
+
+/**
+ * @brief Combines two partial results of a reduction. Like llvm.minnum and
+ * llvm.maxnum, min and max only return NaN if both operands are NaNs
+ *
+ */
+template <typename T> T ApplyReduceStep(ReduceOpcode Opcode, T a, T b) {
+  switch (Opcode) {
+  case Reduce_fadd:
+    return a + b;
+  case Reduce_fmul:
+    return a * b;
+  case Reduce_fmin:
+    return (utils::isnan(b) || a < b) ? a : b;
+  case Reduce_fmax:
+    return (utils::isnan(b) || a > b) ? a : b;
+  }
+  utils::unreachable("Unknown reduction");
+}
+
+/**
+ * @brief Reduces the lanes of a vector and combines the result with Start
+ *
+ * Strict reductions are sequential, Start with lane 0, then lane 1, and so
+ * on, as llvm.vector.reduce.* without reassoc. With Reassoc, lanes are
+ * reduced pairwise by halves, lane I with lane I + Size / 2, and then
+ * combined with Start. This gives the native value the program computes,
+ * and the backends reduce the shadows in the same order, so that they see
+ * the same cancellations.
+ */
+template <typename ScalarT, typename VectorT>
+ScalarT ApplyReduce(ReduceOpcode Opcode, bool Reassoc, ScalarT Start,
+                    VectorT Vec) {
+  if constexpr (std::is_same_v<ScalarT, VectorT>)
+    return ApplyReduceStep(Opcode, Start, Vec);
+  else {
+    constexpr size_t Size = sizeof(VectorT) / sizeof(ScalarT);
+    if (not Reassoc) {
+      for (size_t I = 0; I < Size; I++)
+        Start = ApplyReduceStep(Opcode, Start, Vec[I]);
+      return Start;
+    }
+
+    ScalarT Lanes[Size];
+    for (size_t I = 0; I < Size; I++)
+      Lanes[I] = Vec[I];
+    for (size_t Width = Size / 2; Width > 0; Width /= 2)
+      for (size_t I = 0; I < Width; I++)
+        Lanes[I] = ApplyReduceStep(Opcode, Lanes[I], Lanes[I + Width]);
+    return ApplyReduceStep(Opcode, Start, Lanes[0]);
+  }
+}
+
+/**
+ * @brief Shadows of the lanes of a vector, Stride bytes apart
+ *
+ * Lanes loaded from, or stored to, contiguous memory have contiguous shadows
+ * in nsan's shadow memory. Their stride is then the size of a backend shadow.
+ */
+template <typename ShadowType> struct ShadowSpan {
+  ShadowType *Base;
+  size_t Stride;
+
+  ShadowType *operator[](size_t Lane) const {
+    return reinterpret_cast<ShadowType *>(reinterpret_cast<char *>(Base) +
+                                          Lane * Stride);
+  }
+
+  // Pointer arrays of the other entry points
+  template <size_t Size> void gather(ShadowType **Res) const {
+    for (size_t I = 0; I < Size; I++)
+      Res[I] = (*this)[I];
+  }
+};
+
 // Forward declaration to avoid circular inclusion
 class InsaneContext;
 
@@ -59,6 +311,90 @@ void BackendInit(InsaneContext &Context) noexcept;
  */
 void BackendFinalize(InsaneContext &Context) noexcept;
 
+/**
+ * @brief What a failed check does besides returning true, as a mask of the
+ * Report_* values
+ *
+ * Check and CheckFCmp are specialized on the policy, so that the disabled
+ * features cost nothing on the failure path. Report_FromFlags reads the
+ * context flags on every failure instead.
+ */
+enum ReportPolicy : unsigned {
+  Report_CountOnly = 0,
+  Report_StackRecording = 1,
+  Report_Warnings = 2,
+  Report_ExitOnError = 4,
+  Report_FromFlags = 8
+};
+
+class RuntimeFlags;
+
+// Mask of the features enabled by the flags, Report_FromFlags excluded
+unsigned ReportPolicyFor(RuntimeFlags const &Flags);
+
+// Whether Feature is enabled by the context flags
+bool FlagsReport(ReportPolicy Feature);
+
+// Whether a failed check does Feature under Policy, constant unless the
+// policy is read from the flags
+template <unsigned Policy>
+__attribute__((always_inline)) inline bool Reports(ReportPolicy Feature) {
+  if constexpr (Policy == Report_FromFlags)
+    return FlagsReport(Feature);
+  else
+    return Policy & Feature;
+}
+
+/**
+ * @brief Calls F with std::integral_constant<unsigned, Value>, so that a
+ * policy known at runtime selects a specialization
+ */
+template <unsigned Policy = Report_CountOnly, typename Function>
+void WithReportPolicy(unsigned Value, Function F) {
+  if constexpr (Policy < Report_FromFlags) {
+    if (Value == Policy)
+      F(std::integral_constant<unsigned, Policy>{});
+    else
+      WithReportPolicy<Policy + 1>(Value, F);
+  } else
+    F(std::integral_constant<unsigned, Report_FromFlags>{});
+}
+
+/**
+ * @brief Binds the interface's checks to the specializations matching the
+ * flags, called once by __interflop_init. Until then, they use
+ * Report_FromFlags
+ *
+ * Defined by the generated interface. Weak, so that the core may be linked
+ * without an interface, as in the backend tests.
+ *
+ * @param Flags Loaded runtime flags
+ */
+void BindReportPolicy(RuntimeFlags const &Flags) __attribute__((weak));
+
+/**
+ * @brief Instruction of the instrumented program that called the interface
+ *
+ * Set by the generated interface entries that may emit warnings, so that the
+ * recorder can recognize a site without unwinding the stack.
+ */
+struct Callsite {
+  void const *Address = nullptr;
+  // Frame of the interface entry, tells apart the calling contexts of a site
+  void const *Frame = nullptr;
+};
+
+inline thread_local Callsite CurrentCallsite;
+
+// Sets the current callsite for the lifetime of the scope
+class CallsiteScope {
+public:
+  CallsiteScope(void const *Address, void const *Frame) {
+    CurrentCallsite = {Address, Frame};
+  }
+  ~CallsiteScope() { CurrentCallsite = {}; }
+};
+
 class WarningRecorder {
 public:
   void Record();
@@ -68,7 +404,7 @@ public:
 
 private:
   virtual void RecordImpl() = 0;
-  size_t WarningCount = 0;
+  std::atomic<size_t> WarningCount{0};
 };
 
 /**
@@ -77,11 +413,15 @@ private:
  * Registers stacktraces that will be printed at the end of the program if
  * warnings are enabled. Uses clang stacktrace library
  *
+ * Each thread counts its stacktraces in its own shard, so that recording never
+ * takes a lock. Shards are merged into the global map at thread exit and when
+ * printing. Stacktraces that do not fit in a shard go to the global map.
+ *
  * Should be replaced by the std stacktrace library in the future
  */
 class StacktraceRecorder : public WarningRecorder {
 public:
-  virtual ~StacktraceRecorder() = default;
+  virtual ~StacktraceRecorder();
 
   /**
    * @brief Pretty print every recorded stacktrace to the given stream.
@@ -92,21 +432,67 @@ public:
    */
   void print(std::string const &BackendName, std::ostream &out);
 
+  /**
+   * @brief Stacktrace id of the current callsite, unwinds the stack only if
+   * the callsite is unknown to this thread
+   *
+   * @return uint32_t
+   */
+  static uint32_t CurrentStackId();
+
+  /**
+   * @brief Per-thread flat open-addressing map from stacktrace id to count
+   *
+   * Only its thread writes to it, but the merging thread may read it
+   * concurrently, hence the relaxed atomics. The storage is part of the
+   * thread-local shard itself, it is never reallocated.
+   */
+  struct Shard {
+    static constexpr size_t Capacity = 256;
+    static constexpr uint32_t EmptyKey = UINT32_MAX;
+
+    std::atomic<uint32_t> Keys[Capacity];
+    std::atomic<uint32_t> Counts[Capacity];
+
+    // Stacktrace ids of the known callsites, only used by the shard's thread
+    // The full stack is unwound the first time a site is seen only
+    void const *SiteAddresses[Capacity] = {};
+    void const *SiteFrames[Capacity] = {};
+    uint32_t SiteStacks[Capacity] = {};
+
+    // Changed under the owner lock only, see Interflop.cpp. Read by the
+    // shard's thread to know whether it is registered
+    std::atomic<StacktraceRecorder *> Owner{nullptr};
+    Shard *Next = nullptr;
+    Shard *Prev = nullptr;
+
+    Shard();
+    ~Shard();
+
+    // Returns false if the shard is full
+    bool Increment(uint32_t StackId);
+
+    // Returns the stack id of a known site, or unwinds the stack
+    uint32_t StackIdFor(Callsite const &Site);
+  };
+
 private:
   /**
    * @brief Records a stacktrace and store its Id for later printing
    *
    */
-  void RecordImpl() {
-    // Clang stack parsing should be thread safe
-    size_t SId = utils::SaveStackTrace();
+  void RecordImpl();
 
-    std::scoped_lock<std::mutex> lock(Mutex);
-    Map[SId]++;
-  }
+  using StackMap = std::unordered_map<uint32_t, int>;
+
+  static void MergeShard(Shard const &Source, StackMap &Target);
+  void Register(Shard &Source);
+  void Unregister(Shard &Source);
 
   // FIXME: We should probably store an error message along the stacktrace
-  std::unordered_map<uint32_t, int> Map;
+  StackMap Map;
+  // Shards of the live threads
+  Shard *Shards = nullptr;
   std::mutex Mutex;
 };
 
@@ -120,6 +506,7 @@ private:
 template <typename MetaFP> class InsaneRuntime {
 public:
   using FPType = typename MetaFP::FPType;
+  using ScalarType = typename MetaFP::ScalarType;
   using ShadowType = typename MetaFP::ShadowType;
   static constexpr size_t VectorSize = MetaFP::VectorSize;
 
@@ -188,20 +575,101 @@ public:
   FPType Div(FPType a, ShadowType **sa, FPType b, ShadowType **sb,
              ShadowType **res);
 
+  /**
+   * @brief FP Fused multiply-add. Should return fma(a, b, c) and store
+   * sa * sb + sc in res, with a single rounding like the native operation
+   *
+   * @param a First FP factor
+   * @param sa Shadow of a
+   * @param b Second FP factor
+   * @param sb shadow of b
+   * @param c FP addend
+   * @param sc shadow of c
+   * @param res Return shadow
+   * @return FPType Should be fma(a, b, c)
+   */
+  FPType Fma(FPType a, ShadowType **sa, FPType b, ShadowType **sb, FPType c,
+             ShadowType **sc, ShadowType **res);
+
+  /**
+   * @brief libm function call. Should return f(a) and store f(sa) in res,
+   * with f the function given by Opcode. Math_pow is handled by Pow
+   *
+   * @param Opcode libm function
+   * @param a FP operand
+   * @param sa Shadow of a
+   * @param res Return shadow
+   * @return FPType Should be f(a)
+   */
+  FPType Math(MathOpcode Opcode, FPType a, ShadowType **sa, ShadowType **res);
+
+  /**
+   * @brief libm pow call. Should return pow(a, b) and store pow(sa, sb) in
+   * res
+   *
+   * @param a Base FP operand
+   * @param sa Shadow of a
+   * @param b Exponent FP operand
+   * @param sb shadow of b
+   * @param res Return shadow
+   * @return FPType Should be pow(a, b)
+   */
+  FPType Pow(FPType a, ShadowType **sa, FPType b, ShadowType **sb,
+             ShadowType **res);
+
+  /**
+   * @brief Horizontal reduction of a vector. Should return Start (OPCODE) the
+   * reduction of a, and store the same reduction of the shadows in res. See
+   * ApplyReduce for the evaluation order
+   *
+   * @param Opcode Reduction opcode
+   * @param Reassoc Whether the reduction may be reassociated
+   * @param Start FP start value
+   * @param sstart Shadow of Start
+   * @param a FP vector operand
+   * @param sa Shadow of a
+   * @param res Return shadow, a scalar shadow
+   * @return ScalarType Should be ApplyReduce(Opcode, Reassoc, Start, a)
+   */
+  ScalarType Reduce(ReduceOpcode Opcode, bool Reassoc, ScalarType Start,
+                    ShadowType **sstart, FPType a, ShadowType **sa,
+                    ShadowType **res);
+
+  /**
+   * @brief Same as Add, Sub, Mul and Div, with the lane shadows given as
+   * spans instead of pointer arrays. Contiguous shadows are loaded and stored
+   * with vectors, other strides fall back to the pointer array operators
+   *
+   * @param Opcode Binary opcode
+   * @param a First FP operand
+   * @param sa Shadow of a
+   * @param b Second FP operand
+   * @param sb shadow of b
+   * @param res Return shadow
+   * @return FPType Should be a (OPCODE) b
+   */
+  FPType Binary(simd::BinaryOpcode Opcode, FPType a, ShadowSpan<ShadowType> sa,
+                FPType b, ShadowSpan<ShadowType> sb,
+                ShadowSpan<ShadowType> res);
+
   /**
    * @brief Performs an accuracy check using a FP and its shadow
    *
+   * @tparam Policy What a failure does besides returning true, see
+   * ReportPolicy
    * @param a FP Operand
    * @param sa Shadow of a
    * @return true if an error is detected
    * @return false if there's no error
    */
+  template <unsigned Policy = Report_FromFlags>
   bool Check(FPType a, ShadowType **sa);
 
   /**
    * @brief Check the accuracy of an FP comparison
    *
-   * @param Opcode Comparisons opcode
+   * @tparam Opcode Comparisons opcode
+   * @tparam Policy What a failure does, see ReportPolicy
    * @param LeftOperand FP first operand
    * @param LeftShadowOperand Shadow first operand
    * @param RightOperand FP second operand
@@ -210,6 +678,15 @@ public:
    * @return true if the comparisons is correct
    * @return false if the comparisons is incorrect
    */
+  template <FCmpOpcode Opcode, unsigned Policy = Report_FromFlags>
+  bool CheckFCmp(FPType LeftOperand, ShadowType **LeftShadowOperand,
+                 FPType RightOperand, ShadowType **RightShadowOperand,
+                 bool Value);
+
+  /**
+   * @brief Same as CheckFCmp, with the opcode known at runtime and the policy
+   * read from the flags
+   */
   bool CheckFCmp(FCmpOpcode Opcode, FPType LeftOperand,
                  ShadowType **LeftShadowOperand, FPType RightOperand,
                  ShadowType **RightShadowOperand, bool Value);
@@ -226,6 +703,27 @@ public:
    */
   void MakeShadow(FPType a, ShadowType **res);
 
+  /**
+   * @brief Bulk shadow constructor, same as MakeShadow on each of the Count
+   * values of a. The shadows of contiguous values are contiguous in nsan's
+   * shadow memory, so only the first one is given
+   *
+   * @param a FP values
+   * @param res Shadow of a[0], followed by the other shadows
+   * @param Count Number of values
+   */
+  void MakeShadowRange(ScalarType const *a, ShadowType *res, size_t Count);
+
+  /**
+   * @brief Copies the shadows of Count contiguous values, for memcpy-like
+   * copies of FP arrays. The ranges may overlap
+   *
+   * @param res Shadow of the first destination value
+   * @param sa Shadow of the first source value
+   * @param Count Number of values
+   */
+  void CopyShadowRange(ShadowType *res, ShadowType const *sa, size_t Count);
+
   /**
    * @brief Cast a FP to a another FP type. The FP cast is performed in the
    * instrumentation, only the shadow cast is left to the runtime
@@ -256,4 +754,80 @@ public:
    */
   void CastToLongdouble(FPType a, ShadowType **sa, OpaqueLargeShadow **res);
 };
+
+template <typename MetaFP>
+bool InsaneRuntime<MetaFP>::CheckFCmp(FCmpOpcode Opcode, FPType a,
+                                      ShadowType **sa, FPType b,
+                                      ShadowType **sb, bool Value) {
+  switch (Opcode) {
+  case FCmp_oeq:
+    return CheckFCmp<FCmp_oeq>(a, sa, b, sb, Value);
+  case FCmp_one:
+    return CheckFCmp<FCmp_one>(a, sa, b, sb, Value);
+  case FCmp_ogt:
+    return CheckFCmp<FCmp_ogt>(a, sa, b, sb, Value);
+  case FCmp_oge:
+    return CheckFCmp<FCmp_oge>(a, sa, b, sb, Value);
+  case FCmp_olt:
+    return CheckFCmp<FCmp_olt>(a, sa, b, sb, Value);
+  case FCmp_ole:
+    return CheckFCmp<FCmp_ole>(a, sa, b, sb, Value);
+  case FCmp_ueq:
+    return CheckFCmp<FCmp_ueq>(a, sa, b, sb, Value);
+  case FCmp_une:
+    return CheckFCmp<FCmp_une>(a, sa, b, sb, Value);
+  case FCmp_ugt:
+    return CheckFCmp<FCmp_ugt>(a, sa, b, sb, Value);
+  case FCmp_uge:
+    return CheckFCmp<FCmp_uge>(a, sa, b, sb, Value);
+  case FCmp_ult:
+    return CheckFCmp<FCmp_ult>(a, sa, b, sb, Value);
+  case FCmp_ule:
+    return CheckFCmp<FCmp_ule>(a, sa, b, sb, Value);
+  default:
+    utils::unreachable("Unknown predicate");
+  }
+}
+
+// Explicit instantiation of a runtime by a backend. Member templates are not
+// instantiated by "template class", and implicit instantiations may be
+// discarded by link-time optimization. Variadic since MetaFloat<T, N> contains
+// a comma
+#define INSANE_INSTANTIATE_CHECK_FCMP(Opcode, Policy, ...)                     \
+  template bool InsaneRuntime<__VA_ARGS__>::CheckFCmp<Opcode, Policy>(         \
+      InsaneRuntime<__VA_ARGS__>::FPType,                                      \
+      InsaneRuntime<__VA_ARGS__>::ShadowType **,                               \
+      InsaneRuntime<__VA_ARGS__>::FPType,                                      \
+      InsaneRuntime<__VA_ARGS__>::ShadowType **, bool)
+
+#define INSANE_INSTANTIATE_CHECKS(Policy, ...)                                 \
+  template bool InsaneRuntime<__VA_ARGS__>::Check<Policy>(                     \
+      InsaneRuntime<__VA_ARGS__>::FPType,                                      \
+      InsaneRuntime<__VA_ARGS__>::ShadowType **);                              \
+  INSANE_INSTANTIATE_CHECK_FCMP(FCmp_oeq, Policy, __VA_ARGS__);                \
+  INSANE_INSTANTIATE_CHECK_FCMP(FCmp_one, Policy, __VA_ARGS__);                \
+  INSANE_INSTANTIATE_CHECK_FCMP(FCmp_ogt, Policy, __VA_ARGS__);                \
+  INSANE_INSTANTIATE_CHECK_FCMP(FCmp_oge, Policy, __VA_ARGS__);                \
+  INSANE_INSTANTIATE_CHECK_FCMP(FCmp_olt, Policy, __VA_ARGS__);                \
+  INSANE_INSTANTIATE_CHECK_FCMP(FCmp_ole, Policy, __VA_ARGS__);                \
+  INSANE_INSTANTIATE_CHECK_FCMP(FCmp_ueq, Policy, __VA_ARGS__);                \
+  INSANE_INSTANTIATE_CHECK_FCMP(FCmp_une, Policy, __VA_ARGS__);                \
+  INSANE_INSTANTIATE_CHECK_FCMP(FCmp_ugt, Policy, __VA_ARGS__);                \
+  INSANE_INSTANTIATE_CHECK_FCMP(FCmp_uge, Policy, __VA_ARGS__);                \
+  INSANE_INSTANTIATE_CHECK_FCMP(FCmp_ult, Policy, __VA_ARGS__);                \
+  INSANE_INSTANTIATE_CHECK_FCMP(FCmp_ule, Policy, __VA_ARGS__)
+
+// Every policy from Report_CountOnly to Report_FromFlags
+#define INSANE_INSTANTIATE_RUNTIME(...)                                        \
+  template class InsaneRuntime<__VA_ARGS__>;                                   \
+  INSANE_INSTANTIATE_CHECKS(0, __VA_ARGS__);                                   \
+  INSANE_INSTANTIATE_CHECKS(1, __VA_ARGS__);                                   \
+  INSANE_INSTANTIATE_CHECKS(2, __VA_ARGS__);                                   \
+  INSANE_INSTANTIATE_CHECKS(3, __VA_ARGS__);                                   \
+  INSANE_INSTANTIATE_CHECKS(4, __VA_ARGS__);                                   \
+  INSANE_INSTANTIATE_CHECKS(5, __VA_ARGS__);                                   \
+  INSANE_INSTANTIATE_CHECKS(6, __VA_ARGS__);                                   \
+  INSANE_INSTANTIATE_CHECKS(7, __VA_ARGS__);                                   \
+  INSANE_INSTANTIATE_CHECKS(Report_FromFlags, __VA_ARGS__)
+
 } // namespace insane
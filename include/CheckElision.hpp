@@ -0,0 +1,137 @@
+/**
+ * @file CheckElision.hpp
+ * @brief Per-callsite adaptive elision of the shadow checks.
+ * @version 0.1.0
+ *
+ *
+ */
+
+#pragma once
+#include "Flags.hpp"
+#include <atomic>
+#include <cstdint>
+
+namespace insane {
+
+/**
+ * @brief Tracks the check history of each callsite, so that sites that keep
+ * passing are checked less and less often
+ *
+ * Once a site has passed Warmup checks in a row, the number of checks skipped
+ * before the next one doubles after each pass, up to MaxInterval. A failure
+ * resets the site to full checking, but only if it happens on a call that is
+ * checked: elided calls are not evaluated at all. This is sampling, a site
+ * whose errors only show on some calls, say 1 in 1000, may never be reported
+ * once its interval is large. Elision trades these reports for speed, and
+ * should be left off when every first occurrence matters.
+ *
+ * The table is fixed-size and lock-free. Sites that do not fit are always
+ * checked. Counters are updated with relaxed atomics: concurrent threads may
+ * check a site slightly more or less often than planned, which is harmless.
+ */
+class CheckElisionTable {
+public:
+  struct Site {
+    std::atomic<uintptr_t> Address{0};
+    // Consecutive passing checks
+    std::atomic<uint32_t> Passes{0};
+    // Checks left to skip before the next one
+    std::atomic<uint32_t> Countdown{0};
+
+    /**
+     * @brief Decides whether this call must run the backend check
+     *
+     * @return true if the check must be performed
+     */
+    bool ShouldCheck() {
+      uint32_t Left = Countdown.load(std::memory_order_relaxed);
+      if (Left == 0)
+        return true;
+      Countdown.store(Left - 1, std::memory_order_relaxed);
+      return false;
+    }
+
+    /**
+     * @brief Updates the site history with the result of a performed check
+     *
+     * @param Failed true if the backend detected an error
+     * @param Table Owning table, for the elision parameters
+     */
+    void Report(bool Failed, CheckElisionTable const &Table) {
+      if (Failed) {
+        Passes.store(0, std::memory_order_relaxed);
+        Countdown.store(0, std::memory_order_relaxed);
+        return;
+      }
+
+      uint32_t Count = Passes.load(std::memory_order_relaxed) + 1;
+      Passes.store(Count, std::memory_order_relaxed);
+      if (Count > Table.Warmup)
+        Countdown.store(Table.IntervalAfter(Count - Table.Warmup),
+                        std::memory_order_relaxed);
+    }
+  };
+
+  // The table is constant-initialized, so this accessor has no guard
+  static CheckElisionTable &getInstance() {
+    static CheckElisionTable Table;
+    return Table;
+  }
+
+  /**
+   * @brief Loads the elision parameters. Must be called before any check
+   *
+   * @param Flags
+   */
+  void Configure(RuntimeFlags const &Flags);
+
+  /**
+   * @brief Finds or inserts the entry of a callsite
+   *
+   * @param Address Return address of the interface entry
+   * @return Site* nullptr if elision is disabled or the table is full
+   */
+  Site *Lookup(void const *Address) {
+    if (not Enabled)
+      return nullptr;
+
+    uintptr_t Key = reinterpret_cast<uintptr_t>(Address);
+    // Fibonacci hashing, instructions addresses have few significant low bits
+    size_t Slot = (Key * 0x9E3779B97F4A7C15ull) >> (64 - TableBits);
+
+    for (size_t Probe = 0; Probe < MaxProbes; Probe++) {
+      Site &Entry = Sites[(Slot + Probe) & (TableSize - 1)];
+      uintptr_t Current = Entry.Address.load(std::memory_order_acquire);
+      if (Current == Key)
+        return &Entry;
+      if (Current == 0 && Entry.Address.compare_exchange_strong(
+                              Current, Key, std::memory_order_acq_rel))
+        return &Entry;
+      // Another thread may have inserted the same key
+      if (Current == Key)
+        return &Entry;
+    }
+    return nullptr;
+  }
+
+private:
+  static constexpr size_t TableBits = 12;
+  static constexpr size_t TableSize = size_t(1) << TableBits;
+  static constexpr size_t MaxProbes = 16;
+
+  CheckElisionTable() = default;
+
+  uint32_t IntervalAfter(uint32_t StablePasses) const {
+    if (StablePasses >= 32)
+      return MaxInterval;
+    uint64_t Interval = uint64_t(1) << StablePasses;
+    return Interval < MaxInterval ? Interval : MaxInterval;
+  }
+
+  bool Enabled = false;
+  uint32_t Warmup = 0;
+  uint32_t MaxInterval = 0;
+  Site Sites[TableSize];
+};
+
+} // namespace insane
@@ -13,6 +13,7 @@
 #include "Flags.hpp"
 #include "OpaqueShadow.hpp"
 #include "Utils.hpp"
+#include <atomic>
 #include <iostream>
 #include <memory>
 #include <shared_mutex>
@@ -90,6 +91,15 @@ public:
    */
   RuntimeFlags &Flags() { return RTFlags; }
 
+  /**
+   * @brief Whether the flags were loaded, before that they are the defaults
+   *
+   * @return bool
+   */
+  bool isInitialized() const {
+    return Initialized.load(std::memory_order_acquire);
+  }
+
 private:
   /**
    * @brief Private constructor to ensure singleton state
@@ -97,11 +107,13 @@ private:
    */
   InsaneContext() = default;
 
-  bool Initialized{false};
+  std::atomic<bool> Initialized{false};
   std::string BackendName{"Undefined_Backend"};
 
   RuntimeFlags RTFlags;
-  std::unique_ptr<WarningRecorder> WRecorder;
+  // Checks may fail and record before Init, with the default flags
+  std::unique_ptr<WarningRecorder> WRecorder =
+      std::make_unique<StacktraceRecorder>();
 
   std::shared_mutex MainContextMutex;
 };
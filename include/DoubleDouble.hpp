@@ -0,0 +1,227 @@
+/**
+ * @file DoubleDouble.hpp
+ * @brief Error-free transformations and double-double arithmetic, used as a
+ * fast replacement for __float128.
+ * @version 0.1.0
+ *
+ *
+ */
+
+#pragma once
+#include "Utils.hpp"
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <type_traits>
+
+namespace insane {
+
+/* ========================================================================= */
+/* Error-free transformations                                                */
+/* Also work on GCC vectors, except for the FMA TwoProd. Always inlined, so  */
+/* that vectors never cross the ABI of the lane kernels' instruction sets    */
+/* ========================================================================= */
+namespace eft {
+
+// Sum + Error == a + b exactly, with Sum = fl(a + b)
+template <typename T>
+__attribute__((always_inline)) inline void TwoSum(T a, T b, T &Sum, T &Error) {
+  Sum = a + b;
+  T bVirtual = Sum - a;
+  Error = (a - (Sum - bVirtual)) + (b - bVirtual);
+}
+
+// Same as TwoSum, but requires |a| >= |b|
+template <typename T>
+__attribute__((always_inline)) inline void FastTwoSum(T a, T b, T &Sum,
+                                                   T &Error) {
+  Sum = a + b;
+  Error = b - (Sum - a);
+}
+
+// Veltkamp splitting, Hi + Lo == a with half the mantissa in each
+template <typename T>
+__attribute__((always_inline)) inline void Split(T a, T &Hi, T &Lo) {
+  using ScalarT = std::remove_reference_t<decltype(Hi[0])>;
+  constexpr int Shift = (std::numeric_limits<ScalarT>::digits + 1) / 2;
+  T Tmp = a * ScalarT((1ull << Shift) + 1);
+  Hi = Tmp - (Tmp - a);
+  Lo = a - Hi;
+}
+
+template <>
+__attribute__((always_inline)) inline void Split(float a, float &Hi,
+                                                 float &Lo) {
+  float Tmp = a * 4097.0f;
+  Hi = Tmp - (Tmp - a);
+  Lo = a - Hi;
+}
+
+template <>
+__attribute__((always_inline)) inline void Split(double a, double &Hi,
+                                                 double &Lo) {
+  double Tmp = a * 134217729.0;
+  Hi = Tmp - (Tmp - a);
+  Lo = a - Hi;
+}
+
+// Prod + Error == a * b exactly, with Prod = fl(a * b)
+// Uses a FMA when the hardware supports it, and Dekker's product otherwise
+template <typename T>
+__attribute__((always_inline)) inline void TwoProd(T a, T b, T &Prod,
+                                                   T &Error) {
+  Prod = a * b;
+#ifdef __FMA__
+  if constexpr (std::is_floating_point_v<T>) {
+    Error = std::fma(a, b, -Prod);
+    return;
+  }
+#endif
+  T aHi, aLo, bHi, bLo;
+  Split(a, aHi, aLo);
+  Split(b, bHi, bLo);
+  Error = ((aHi * bHi - Prod) + aHi * bLo + aLo * bHi) + aLo * bLo;
+}
+
+} // namespace eft
+
+/**
+ * @brief Unevaluated sum of two doubles, with |lo| <= ulp(hi) / 2
+ *
+ * Gives 106 bits of mantissa using only hardware double arithmetic, while
+ * __float128 relies on libquadmath software emulation. Unlike __float128, the
+ * exponent range is the same as double.
+ *
+ * Algorithms from Joldes, Muller and Popescu, "Tight and rigorous error bounds
+ * for basic building blocks of double-word arithmetic" (2017)
+ */
+struct DoubleDouble {
+  double hi = 0;
+  double lo = 0;
+
+  constexpr DoubleDouble() = default;
+
+  // A single template constructor avoids ambiguous conversions from integers
+  template <typename T,
+            typename = std::enable_if_t<std::is_arithmetic_v<T> ||
+                                        std::is_same_v<T, __float128>>>
+  DoubleDouble(T x) : hi(static_cast<double>(x)) {
+    // Keep the bits that do not fit in a double
+    if constexpr (sizeof(T) > sizeof(double))
+      if (std::isfinite(hi))
+        lo = static_cast<double>(x - static_cast<T>(hi));
+  }
+
+  // The result of a double operation and its rounding error
+  static DoubleDouble sum(double a, double b) {
+    DoubleDouble Res;
+    eft::TwoSum(a, b, Res.hi, Res.lo);
+    return Res;
+  }
+
+  static DoubleDouble product(double a, double b) {
+    DoubleDouble Res;
+    eft::TwoProd(a, b, Res.hi, Res.lo);
+    return Res;
+  }
+
+  // Not exact, but accurate to 2^-104
+  static DoubleDouble quotient(double a, double b) {
+    double Quotient = a / b;
+    if (not std::isfinite(Quotient) || Quotient == 0)
+      return Quotient;
+    double Prod, ProdError;
+    eft::TwoProd(Quotient, b, Prod, ProdError);
+    DoubleDouble Res;
+    eft::FastTwoSum(Quotient, ((a - Prod) - ProdError) / b, Res.hi, Res.lo);
+    return Res;
+  }
+
+  explicit operator float() const { return static_cast<float>(hi + lo); }
+  explicit operator double() const { return hi + lo; }
+  explicit operator long double() const {
+    return static_cast<long double>(hi) + lo;
+  }
+
+  DoubleDouble operator-() const {
+    DoubleDouble Res;
+    Res.hi = -hi;
+    Res.lo = -lo;
+    return Res;
+  }
+
+  friend DoubleDouble operator+(DoubleDouble const &x, DoubleDouble const &y) {
+    double SumHi, SumLo, TailHi, TailLo, Hi, Lo;
+    eft::TwoSum(x.hi, y.hi, SumHi, SumLo);
+    // The error terms of infinites are NaNs
+    if (not std::isfinite(SumHi))
+      return SumHi;
+    eft::TwoSum(x.lo, y.lo, TailHi, TailLo);
+    eft::FastTwoSum(SumHi, SumLo + TailHi, Hi, Lo);
+    DoubleDouble Res;
+    eft::FastTwoSum(Hi, TailLo + Lo, Res.hi, Res.lo);
+    return Res;
+  }
+
+  friend DoubleDouble operator-(DoubleDouble const &x, DoubleDouble const &y) {
+    return x + (-y);
+  }
+
+  friend DoubleDouble operator*(DoubleDouble const &x, DoubleDouble const &y) {
+    double Hi, Lo;
+    eft::TwoProd(x.hi, y.hi, Hi, Lo);
+    if (not std::isfinite(Hi))
+      return Hi;
+    Lo += x.hi * y.lo + x.lo * y.hi;
+    DoubleDouble Res;
+    eft::FastTwoSum(Hi, Lo, Res.hi, Res.lo);
+    return Res;
+  }
+
+  friend DoubleDouble operator/(DoubleDouble const &x, DoubleDouble const &y) {
+    double Hi = x.hi / y.hi;
+    if (not std::isfinite(Hi) || Hi == 0)
+      return Hi;
+    DoubleDouble Remainder = x - y * DoubleDouble(Hi);
+    DoubleDouble Res;
+    eft::FastTwoSum(Hi, Remainder.hi / y.hi, Res.hi, Res.lo);
+    return Res;
+  }
+
+  friend bool operator==(DoubleDouble const &x, DoubleDouble const &y) {
+    return x.hi == y.hi && x.lo == y.lo;
+  }
+  friend bool operator!=(DoubleDouble const &x, DoubleDouble const &y) {
+    return not(x == y);
+  }
+  friend bool operator<(DoubleDouble const &x, DoubleDouble const &y) {
+    return x.hi < y.hi || (x.hi == y.hi && x.lo < y.lo);
+  }
+  friend bool operator>(DoubleDouble const &x, DoubleDouble const &y) {
+    return y < x;
+  }
+  friend bool operator<=(DoubleDouble const &x, DoubleDouble const &y) {
+    return x < y || x == y;
+  }
+  friend bool operator>=(DoubleDouble const &x, DoubleDouble const &y) {
+    return y <= x;
+  }
+
+  friend std::ostream &operator<<(std::ostream &os, DoubleDouble const &x) {
+    return os << static_cast<long double>(x);
+  }
+};
+
+static_assert(sizeof(DoubleDouble) == sizeof(__float128),
+              "DoubleDouble must fit in a __float128 shadow");
+
+namespace utils {
+
+template <> inline DoubleDouble abs(DoubleDouble x) {
+  return (x.hi < 0) ? -x : x;
+}
+
+template <> inline bool isnan(DoubleDouble x) { return std::isnan(x.hi); }
+
+} // namespace utils
+} // namespace insane
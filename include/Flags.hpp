@@ -8,7 +8,10 @@
  *
  */
 #pragma once
+#include <cstdint>
 #include <iostream>
+#include <string>
+#include <vector>
 
 namespace insane {
 
@@ -40,6 +43,57 @@ public:
   void setUseColor(bool const value) { UseColor = value; }
   bool getUseColor() const { return UseColor; }
 
+  void setRequiredDigits(size_t const value) { RequiredDigits = value; }
+  size_t getRequiredDigits() const { return RequiredDigits; }
+
+  void setAsyncWarnings(bool const value) { AsyncWarnings = value; }
+  bool getAsyncWarnings() const { return AsyncWarnings; }
+
+  void setCallsiteDedup(bool const value) { CallsiteDedup = value; }
+  bool getCallsiteDedup() const { return CallsiteDedup; }
+
+  void setCallsiteFrameHash(bool const value) { CallsiteFrameHash = value; }
+  bool getCallsiteFrameHash() const { return CallsiteFrameHash; }
+
+  void setCheckElision(bool const value) { CheckElision = value; }
+  bool getCheckElision() const { return CheckElision; }
+
+  void setCheckElisionWarmup(uint32_t const value) {
+    CheckElisionWarmup = value;
+  }
+  uint32_t getCheckElisionWarmup() const { return CheckElisionWarmup; }
+
+  void setCheckElisionMaxInterval(uint32_t const value) {
+    CheckElisionMaxInterval = value;
+  }
+  uint32_t getCheckElisionMaxInterval() const {
+    return CheckElisionMaxInterval;
+  }
+
+  void setMaxISA(std::string const &value) { MaxISA = value; }
+  std::string const &getMaxISA() const { return MaxISA; }
+
+  void setRegionsOnly(bool const value) { RegionsOnly = value; }
+  bool getRegionsOnly() const { return RegionsOnly; }
+
+  void addCheckOnly(std::string const &value) { CheckOnly.push_back(value); }
+  std::vector<std::string> const &getCheckOnly() const { return CheckOnly; }
+
+  void addSkip(std::string const &value) { Skip.push_back(value); }
+  std::vector<std::string> const &getSkip() const { return Skip; }
+
+  void setTrace(bool const value) { Trace = value; }
+  bool getTrace() const { return Trace; }
+
+  void setTracePrefix(std::string const &value) { TracePrefix = value; }
+  std::string const &getTracePrefix() const { return TracePrefix; }
+
+  void setTraceSegmentSize(uint32_t const value) { TraceSegmentSize = value; }
+  uint32_t getTraceSegmentSize() const { return TraceSegmentSize; }
+
+  void setTraceSegments(uint32_t const value) { TraceSegments = value; }
+  uint32_t getTraceSegments() const { return TraceSegments; }
+
   /**
    * @brief Read the environnement var "INSANE_OPTIONS" and parse it for flags
    * 
@@ -84,6 +138,50 @@ private:
   // FIXME : not used yet
   size_t WarningLimit = 20;
   bool Verbose = false;
+
+  // Significant decimal digits a shadow must have to pass a check
+  size_t RequiredDigits = 7;
+
+  // Warnings are formatted and written by a background thread
+  bool AsyncWarnings = true;
+
+  // Warnings from an already seen callsite reuse its stacktrace instead of
+  // unwinding the stack. Sites are told apart by their caller's frame too
+  // with CallsiteFrameHash, at the cost of more unwinding
+  bool CallsiteDedup = true;
+  bool CallsiteFrameHash = false;
+
+  // Callsites that passed CheckElisionWarmup checks in a row are checked
+  // with exponentially decreasing frequency, skipping at most
+  // CheckElisionMaxInterval checks. Errors that only happen on skipped calls
+  // are not reported, see CheckElision.hpp
+  bool CheckElision = false;
+  uint32_t CheckElisionWarmup = 1000;
+  uint32_t CheckElisionMaxInterval = 1 << 16;
+
+  // Best instruction set the kernels may use, when supported by the CPU
+  // One of generic, sse42, avx2 or avx512. The kernels still use the baseline
+  // of the build, so sse42 and generic need an empty INSANE_BASELINE_FLAGS.
+  // See Simd.hpp
+  std::string MaxISA = "avx512";
+
+  // Checks only run between __insane_begin_region and __insane_end_region,
+  // MCASync rounds to nearest elsewhere. See Region.hpp
+  bool RegionsOnly = false;
+
+  // Module or function name patterns, given once per flag. Only the sites in
+  // check_only modules or functions are checked, if any, and never those in
+  // skip ones. See AddressFilter.hpp
+  std::vector<std::string> CheckOnly;
+  std::vector<std::string> Skip;
+
+  // Records every operation of the interface to binary segment files, see
+  // Trace.hpp. Segments are TraceSegmentSize MiB large, and only the last
+  // TraceSegments of each thread are kept, 0 keeps them all
+  bool Trace = false;
+  std::string TracePrefix = "insane";
+  uint32_t TraceSegmentSize = 64;
+  uint32_t TraceSegments = 0;
 };
 
 } // namespace insane
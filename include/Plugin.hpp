@@ -0,0 +1,93 @@
+/**
+ * @file Plugin.hpp
+ * @brief Binary interface between the plugin loader and the backend plugins.
+ * @version 0.1.0
+ *
+ *
+ */
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace insane {
+
+// Bumped whenever the layout of PluginTable changes. Changes of the entry
+// points themselves are caught by the interface hash
+constexpr uint32_t PluginABIVersion = 1;
+
+/**
+ * @brief Entry points of a backend plugin
+ *
+ * Backend plugins are shared libraries containing the core, a backend and the
+ * generated interface. They only export __insane_plugin_table.
+ *
+ * Entries are __interflop_init and the region functions of the core, see
+ * Region.hpp, followed by the generated interface functions, in the order of
+ * InterfaceGenerator.py. InterfaceHash is a hash of their
+ * signatures, so that a loader only binds plugins generated from the same
+ * interface.
+ */
+struct PluginTable {
+  uint32_t Version;
+  uint32_t Count;
+  uint64_t InterfaceHash;
+  void *const *Entries;
+};
+
+/**
+ * @brief Loads the plugin selected by the backend option, once
+ *
+ * The option is read from INSANE_OPTIONS and insane_flags.cfg, its value is
+ * either a path, or a backend name looked up next to the loader as
+ * libinterflop-<name>-plugin.so. Exits if no plugin matching the loader's
+ * interface can be loaded.
+ *
+ * Only relies on the C library, since it may be called before the program's
+ * constructors. The generated loader calls it from a constructor, calls made
+ * before only find the entries through GetPluginEntry.
+ *
+ * @param Count Number of entry points known to the loader
+ * @param InterfaceHash Hash of the loader's entry point signatures
+ * @return void *const* Entries of the plugin
+ */
+void *const *LoadPluginEntries(uint32_t Count, uint64_t InterfaceHash);
+
+// Entries of the loaded plugin, nullptr until LoadPluginEntries returns
+extern std::atomic<void *const *> LoadedPluginEntries;
+
+/**
+ * @brief Returns an entry point of the plugin, see LoadPluginEntries
+ *
+ * @param Index Entry point
+ * @param Count Number of entry points known to the loader
+ * @param InterfaceHash Hash of the loader's entry point signatures
+ * @return void* Address of the plugin's function
+ */
+inline void *GetPluginEntry(size_t Index, uint32_t Count,
+                            uint64_t InterfaceHash) {
+  void *const *Entries = LoadedPluginEntries.load(std::memory_order_acquire);
+  if (__builtin_expect(Entries == nullptr, 0))
+    Entries = LoadPluginEntries(Count, InterfaceHash);
+  return Entries[Index];
+}
+
+/**
+ * @brief Called by the IFUNC resolvers of the loader
+ *
+ * Plugins cannot be loaded while the dynamic linker relocates the program,
+ * which is when the resolvers run if it is linked with immediate binding
+ * (-z now). Forward is then returned instead of the plugin's function, it
+ * reads the entry from LoadedPluginEntries on each call.
+ *
+ * @param Forward Calls GetPluginEntry(Index, ...) and forwards its arguments
+ * @return void* Address of the plugin's function, or Forward
+ */
+void *ResolvePluginEntry(size_t Index, uint32_t Count, uint64_t InterfaceHash,
+                         void *Forward);
+
+} // namespace insane
+
+// Exported by every backend plugin
+extern "C" insane::PluginTable const *__insane_plugin_table();
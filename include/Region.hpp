@@ -0,0 +1,119 @@
+/**
+ * @file Region.hpp
+ * @brief Regions of interest, restricting the shadow checks to parts of the
+ * program.
+ * @version 0.1.0
+ *
+ * The instrumented program brackets its regions of interest with
+ * __insane_begin_region(name) and __insane_end_region(), and may turn checking
+ * off and on for the calling thread with __insane_set_checking. With
+ * regions_only=true, checks only run inside regions.
+ *
+ * While checking is off, Check and CheckFCmp return immediately and MCASync
+ * rounds to nearest. Checks and failures are counted per region, and warnings
+ * name the region they were emitted in.
+ *
+ */
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+namespace insane {
+
+/**
+ * @brief Bits of the per-thread region state
+ *
+ * Zero-initialized, so that a thread reads the flags on its first check. The
+ * checks run when the state is exactly Region_Initialized. Until the context
+ * is initialized, the state is not marked initialized and the flags are read
+ * again on every check.
+ */
+enum RegionStateBits : uint32_t {
+  Region_Initialized = 1,
+  // Outside of any region, with regions_only
+  Region_Outside = 2,
+  // Turned off by __insane_set_checking
+  Region_Disabled = 4
+};
+
+inline thread_local uint32_t RegionState = 0;
+
+// Checks, failed checks and MCASync roundings of the current thread, in its
+// innermost region. Only written by their thread, atomic so that the exit
+// statistics can read the counters of the threads still running
+struct RegionCounters {
+  std::atomic<uint64_t> Checks;
+  std::atomic<uint64_t> Failures;
+  std::atomic<uint64_t> Roundings;
+  std::atomic<uint64_t> ExactRoundings;
+};
+
+inline thread_local RegionCounters LocalRegionCounters = {};
+
+// A single writer needs no atomic read-modify-write
+inline void AddToCounter(std::atomic<uint64_t> &Counter, uint64_t Value) {
+  Counter.store(Counter.load(std::memory_order_relaxed) + Value,
+                std::memory_order_relaxed);
+}
+
+// Sets the state of a thread from the flags, returns whether it checks
+bool InitRegionState();
+
+/**
+ * @brief Whether the calling thread currently checks its shadows
+ *
+ * Tested on every check, and on every MCASync rounding
+ */
+__attribute__((always_inline)) inline bool CheckingEnabled() {
+  uint32_t State = RegionState;
+  if (__builtin_expect(State == Region_Initialized, 1))
+    return true;
+  return not(State & Region_Initialized) && InitRegionState();
+}
+
+// Counts a performed check in the current region
+inline void CountRegionCheck(bool Failed) {
+  AddToCounter(LocalRegionCounters.Checks, 1);
+  AddToCounter(LocalRegionCounters.Failures, Failed);
+}
+
+// Counts stochastic roundings in the current region
+inline void CountRegionRoundings(uint64_t Exact, uint64_t Total) {
+  AddToCounter(LocalRegionCounters.ExactRoundings, Exact);
+  AddToCounter(LocalRegionCounters.Roundings, Total);
+}
+
+/**
+ * @brief Innermost region of the calling thread
+ *
+ * @return uint32_t Region id, 0 outside of any region
+ */
+uint32_t CurrentRegion();
+
+/**
+ * @brief Name of a region
+ *
+ * @param Id Region id, as returned by CurrentRegion
+ * @return char const* Its name, nullptr for 0
+ */
+char const *RegionName(uint32_t Id);
+
+/**
+ * @brief Prints the counts of every region entered so far
+ *
+ * Counts of a region are added up when a thread leaves it or exits. The
+ * current visits of the threads still in a region are read as they run.
+ *
+ * @param Out
+ */
+void PrintRegionStats(std::ostream &Out);
+
+} // namespace insane
+
+// Entry points of the instrumented program, also forwarded by the plugin
+// loader. Regions nest, and are told apart by their names
+extern "C" void __insane_begin_region(char const *name);
+extern "C" void __insane_end_region();
+extern "C" void __insane_set_checking(bool enabled);
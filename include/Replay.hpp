@@ -0,0 +1,231 @@
+/**
+ * @file Replay.hpp
+ * @brief Offline replay of the traces against a backend plugin.
+ * @version 0.1.0
+ *
+ * insane-replay re-executes the operations recorded with trace=true, see
+ * Trace.hpp, by calling the entry points of a backend plugin, see Plugin.hpp.
+ * The replay functions are generated with InterfaceGenerator.py --mode replay,
+ * and decode the records in the order they were written.
+ *
+ * Shadows are kept in a map from their traced address to replay memory. A
+ * shadow read before being written in the replayed stream, such as a shadow
+ * made by another thread or in a previous segment, starts from the recorded
+ * value of the operand, as nsan does for memory written by uninstrumented code.
+ */
+
+#pragma once
+#include "Backend.hpp"
+#include "OpaqueShadow.hpp"
+#include "Trace.hpp"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace insane {
+
+/**
+ * @brief Replay memory of the shadows of one replayed stream
+ *
+ */
+class ReplayShadows {
+public:
+  /**
+   * @param SlotSize Bytes of the largest shadow of the replayed backend, a
+   * power of two
+   */
+  explicit ReplayShadows(size_t SlotSize) : SlotSize(SlotSize) {}
+
+  // Shadow of a traced address, nullptr if it was never written
+  char *Find(uintptr_t Address) const {
+    auto It = Slots.find(Address);
+    return It == Slots.end() ? nullptr : It->second;
+  }
+
+  // Shadow of a traced address, allocated on first use
+  char *Make(uintptr_t Address) {
+    auto [It, Inserted] = Slots.try_emplace(Address, nullptr);
+    if (Inserted)
+      It->second = Allocate();
+    return It->second;
+  }
+
+  // The shadow of the traced address becomes unknown
+  void Forget(uintptr_t Address) {
+    auto It = Slots.find(Address);
+    if (It == Slots.end())
+      return;
+    Free.push_back(It->second);
+    Slots.erase(It);
+  }
+
+  size_t slotSize() const { return SlotSize; }
+
+private:
+  static constexpr size_t BlockSlots = 4096;
+
+  struct BlockDeleter {
+    void operator()(char *Block) const { std::free(Block); }
+  };
+
+  char *Allocate();
+
+  size_t SlotSize;
+  std::unordered_map<uintptr_t, char *> Slots;
+  std::vector<std::unique_ptr<char, BlockDeleter>> Blocks;
+  size_t BlockUsed = BlockSlots;
+  std::vector<char *> Free;
+};
+
+// Checks of a callsite of the traced program in one replayed stream
+struct ReplayCounts {
+  uint64_t Checks;
+  uint64_t Failures;
+};
+
+/**
+ * @brief State of one replayed stream, a sequence of segments replayed in
+ * order for one sample
+ *
+ */
+class ReplayContext {
+public:
+  /**
+   * @param Entries Entry points of the backend plugin
+   * @param TraceScale Shadow scale of the traced program
+   * @param SlotSize See ReplayShadows
+   */
+  ReplayContext(void *const *Entries, uint32_t TraceScale, size_t SlotSize)
+      : Entries(Entries), TraceScale(TraceScale), Shadows(SlotSize) {}
+
+  void *const *Entries;
+
+  // Input shadow of an operation, made from Value if it is unknown
+  template <typename ShadowType, typename ScalarType>
+  ShadowType *Input(uintptr_t Address, ScalarType Value) {
+    char *Slot = Shadows.Find(Address);
+    if (Slot == nullptr) {
+      Slot = Shadows.Make(Address);
+      MakeShadow(Value, reinterpret_cast<ShadowType *>(Slot));
+    }
+    return reinterpret_cast<ShadowType *>(Slot);
+  }
+
+  template <typename ShadowType> ShadowType *Output(uintptr_t Address) {
+    return reinterpret_cast<ShadowType *>(Shadows.Make(Address));
+  }
+
+  // Lane shadows of a vector operand
+  template <typename ShadowType, typename VectorType>
+  void Inputs(TracePayloadReader &Payload, VectorType const &Values,
+              ShadowType **Lanes, size_t Count) {
+    for (size_t I = 0; I < Count; I++)
+      Lanes[I] = Input<ShadowType>(Payload.Shadow(), Values[I]);
+  }
+
+  template <typename ShadowType>
+  void Outputs(TracePayloadReader &Payload, ShadowType **Lanes, size_t Count) {
+    for (size_t I = 0; I < Count; I++)
+      Lanes[I] = Output<ShadowType>(Payload.Shadow());
+  }
+
+  // Same as Inputs and Outputs, for a first shadow and a stride in bytes
+  template <typename ShadowType, typename VectorType>
+  void StridedInputs(TracePayloadReader &Payload, VectorType const &Values,
+                     ShadowType **Lanes, size_t Count) {
+    uintptr_t First = Payload.Shadow();
+    uint64_t Stride = Payload.Size();
+    for (size_t I = 0; I < Count; I++)
+      Lanes[I] = Input<ShadowType>(First + I * Stride, Values[I]);
+  }
+
+  template <typename ShadowType>
+  void StridedOutputs(TracePayloadReader &Payload, ShadowType **Lanes,
+                      size_t Count) {
+    uintptr_t First = Payload.Shadow();
+    uint64_t Stride = Payload.Size();
+    for (size_t I = 0; I < Count; I++)
+      Lanes[I] = Output<ShadowType>(First + I * Stride);
+  }
+
+  // Shadows of a range are not contiguous in replay memory, they are made one
+  // by one
+  template <typename ScalarType, typename ShadowType>
+  void MakeShadowRange(TracePayloadReader &Payload) {
+    uintptr_t First = Payload.Shadow();
+    uint64_t Count = Payload.Size();
+    std::vector<ScalarType> Values(Count);
+    Payload.Values(Values.data(), Count);
+    for (uint64_t I = 0; I < Count; I++)
+      MakeShadow(Values[I],
+                 Output<ShadowType>(First + I * sizeof(ScalarType) * TraceScale));
+  }
+
+  template <typename ScalarType>
+  void CopyShadowRange(TracePayloadReader &Payload) {
+    uintptr_t Res = Payload.Shadow();
+    uintptr_t Operand = Payload.Shadow();
+    uint64_t Count = Payload.Size();
+    size_t Stride = sizeof(ScalarType) * TraceScale;
+    for (uint64_t I = 0; I < Count; I++) {
+      if (char const *Slot = Shadows.Find(Operand + I * Stride))
+        std::memcpy(Shadows.Make(Res + I * Stride), Slot, Shadows.slotSize());
+      else
+        Shadows.Forget(Res + I * Stride);
+    }
+  }
+
+  // Counts a check or a comparison of the traced program
+  void Count(uintptr_t Callsite, bool Failed) {
+    ReplayCounts &Counts = Callsites[Callsite];
+    Counts.Checks++;
+    Counts.Failures += Failed;
+  }
+
+  std::unordered_map<uintptr_t, ReplayCounts> const &callsites() const {
+    return Callsites;
+  }
+
+private:
+  template <typename ScalarType, typename ShadowType>
+  void MakeShadow(ScalarType Value, ShadowType *Shadow);
+
+  uint32_t TraceScale;
+  ReplayShadows Shadows;
+  std::unordered_map<uintptr_t, ReplayCounts> Callsites;
+};
+
+/**
+ * @brief Replays one record
+ *
+ * @param Context Replayed stream
+ * @param Callsite Return address of the entry point in the traced program
+ * @param Payload Parameters of the record
+ */
+using ReplayFunction = void (*)(ReplayContext &Context, uintptr_t Callsite,
+                                TracePayloadReader &Payload);
+
+// Defined by the generated replay, indexed by entry point. Entry points that
+// are never traced have no replay function
+extern ReplayFunction const ReplayEntries[];
+extern size_t const ReplayEntryCount;
+extern uint64_t const ReplayInterfaceHash;
+// Indices of the scalar make_shadow entry points of float, double and long
+// double
+extern size_t const ReplayMakeShadowEntries[3];
+
+template <typename ScalarType, typename ShadowType>
+void ReplayContext::MakeShadow(ScalarType Value, ShadowType *Shadow) {
+  size_t Index = std::is_same_v<ScalarType, float>    ? 0
+                 : std::is_same_v<ScalarType, double> ? 1
+                                                      : 2;
+  using Function = void (*)(ScalarType, ShadowType *);
+  reinterpret_cast<Function>(Entries[ReplayMakeShadowEntries[Index]])(Value,
+                                                                     Shadow);
+}
+
+} // namespace insane
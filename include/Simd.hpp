@@ -0,0 +1,361 @@
+/**
+ * @file Simd.hpp
+ * @brief Helpers for the lane-parallel kernels of the backends.
+ * @version 0.1.0
+ *
+ *
+ */
+
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+
+namespace insane::simd {
+
+// Instruction sets the kernels are compiled for, in increasing order. Generic
+// is the baseline of the build, see CMakeLists.txt
+enum class ISA { Generic, SSE42, AVX2, AVX512 };
+
+// Every variant is also compiled with the baseline, -mavx by default, so the
+// variants below it use more than their name says: the SSE4.2 and Generic
+// kernels, like the rest of the runtime, only run on CPUs without AVX when
+// INSANE_BASELINE_FLAGS is cleared
+inline constexpr char const *BaselineName =
+#if defined(__AVX512F__)
+    "avx512";
+#elif defined(__AVX2__)
+    "avx2";
+#elif defined(__AVX__)
+    "avx";
+#elif defined(__SSE4_2__)
+    "sse42";
+#else
+    "generic";
+#endif
+
+// True if the variants up to Max use instructions of the baseline above Max
+inline constexpr bool BelowBaseline(ISA Max) noexcept {
+#if defined(__AVX512F__)
+  return Max < ISA::AVX512;
+#elif defined(__AVX__)
+  return Max < ISA::AVX2;
+#elif defined(__SSE4_2__)
+  return Max < ISA::SSE42;
+#else
+  return Max < ISA::Generic;
+#endif
+}
+
+// Best instruction set supported by the running CPU
+inline ISA DetectISA() noexcept {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    return ISA::AVX512;
+  if (__builtin_cpu_supports("avx2"))
+    return ISA::AVX2;
+  if (__builtin_cpu_supports("sse4.2"))
+    return ISA::SSE42;
+  return ISA::Generic;
+}
+
+// Written once by __interflop_init, before any kernel runs on another thread
+// Kernels run their Generic variant until then
+inline ISA ActiveISA = ISA::Generic;
+
+inline ISA GetISA() noexcept { return ActiveISA; }
+
+// Selects the best instruction set of the CPU, up to Max
+inline void SelectISA(ISA Max = ISA::AVX512) noexcept {
+  ActiveISA = std::min(Max, DetectISA());
+}
+
+inline char const *ISAName(ISA Value) noexcept {
+  switch (Value) {
+  case ISA::AVX512:
+    return "avx512";
+  case ISA::AVX2:
+    return "avx2";
+  case ISA::SSE42:
+    return "sse42";
+  default:
+    return "generic";
+  }
+}
+
+// GCC vector holding Size elements of type T
+// The compiler splits it into as many registers as the target requires
+template <typename T, size_t Size> struct Vector {
+  using Type __attribute__((vector_size(sizeof(T) * Size))) = T;
+};
+
+template <typename T, size_t Size>
+using Vector_t = typename Vector<T, Size>::Type;
+
+// True if any lane of a comparison mask is set
+template <typename MaskT>
+__attribute__((always_inline)) inline bool Any(MaskT Mask) {
+  constexpr size_t Size = sizeof(MaskT) / sizeof(Mask[0]);
+  auto Res = Mask[0];
+  for (size_t I = 1; I < Size; I++)
+    Res |= Mask[I];
+  return Res != 0;
+}
+
+// True if every lane of a comparison mask is set
+template <typename MaskT>
+__attribute__((always_inline)) inline bool All(MaskT Mask) {
+  constexpr size_t Size = sizeof(MaskT) / sizeof(Mask[0]);
+  auto Res = Mask[0];
+  for (size_t I = 1; I < Size; I++)
+    Res &= Mask[I];
+  return Res != 0;
+}
+
+// Bit I is set if lane I of a comparison mask is set, with one movemask per
+// 128 bits of mask
+template <typename MaskT>
+__attribute__((always_inline)) inline uint64_t MoveMask(MaskT Mask) {
+  constexpr size_t LaneSize = sizeof(Mask[0]);
+  constexpr size_t Size = sizeof(MaskT) / LaneSize;
+  static_assert(Size <= 64, "Too many lanes for a movemask");
+
+  uint64_t Bits = 0;
+  if constexpr (sizeof(MaskT) % 16 == 0 && (LaneSize == 4 || LaneSize == 8)) {
+    constexpr size_t ChunkLanes = 16 / LaneSize;
+    for (size_t Chunk = 0; Chunk < Size / ChunkLanes; Chunk++) {
+      __m128 Part;
+      std::memcpy(&Part, reinterpret_cast<char const *>(&Mask) + 16 * Chunk,
+                  16);
+      uint64_t PartBits = LaneSize == 4
+                              ? _mm_movemask_ps(Part)
+                              : _mm_movemask_pd(_mm_castps_pd(Part));
+      Bits |= PartBits << (Chunk * ChunkLanes);
+    }
+  } else {
+    for (size_t I = 0; I < Size; I++)
+      Bits |= uint64_t(Mask[I] != 0) << I;
+  }
+  return Bits;
+}
+
+// glibc's vector libm, libmvec. The b, d and e variants take 2, 4 and 8
+// doubles in SSE, AVX2 and AVX-512 registers
+extern "C" {
+__m128d _ZGVbN2v_exp(__m128d);
+__m128d _ZGVbN2v_log(__m128d);
+__m128d _ZGVbN2v_sin(__m128d);
+__m128d _ZGVbN2v_cos(__m128d);
+__m128d _ZGVbN2vv_pow(__m128d, __m128d);
+__m256d _ZGVdN4v_exp(__m256d);
+__m256d _ZGVdN4v_log(__m256d);
+__m256d _ZGVdN4v_sin(__m256d);
+__m256d _ZGVdN4v_cos(__m256d);
+__m256d _ZGVdN4vv_pow(__m256d, __m256d);
+__m512d _ZGVeN8v_exp(__m512d);
+__m512d _ZGVeN8v_log(__m512d);
+__m512d _ZGVeN8v_sin(__m512d);
+__m512d _ZGVeN8v_cos(__m512d);
+__m512d _ZGVeN8vv_pow(__m512d, __m512d);
+}
+
+// libmvec functions on Width doubles read from and written to memory. Vectors
+// only live in functions compiled for their instruction set, so that callers
+// of any instruction set share the same calling convention
+template <ISA Target> struct Libmvec {
+  static constexpr size_t Width = 2;
+  static void Sqrt(double const *x, double *Res) {
+    _mm_storeu_pd(Res, _mm_sqrt_pd(_mm_loadu_pd(x)));
+  }
+  static void Exp(double const *x, double *Res) {
+    _mm_storeu_pd(Res, _ZGVbN2v_exp(_mm_loadu_pd(x)));
+  }
+  static void Log(double const *x, double *Res) {
+    _mm_storeu_pd(Res, _ZGVbN2v_log(_mm_loadu_pd(x)));
+  }
+  static void Sin(double const *x, double *Res) {
+    _mm_storeu_pd(Res, _ZGVbN2v_sin(_mm_loadu_pd(x)));
+  }
+  static void Cos(double const *x, double *Res) {
+    _mm_storeu_pd(Res, _ZGVbN2v_cos(_mm_loadu_pd(x)));
+  }
+  static void Pow(double const *x, double const *y, double *Res) {
+    _mm_storeu_pd(Res, _ZGVbN2vv_pow(_mm_loadu_pd(x), _mm_loadu_pd(y)));
+  }
+};
+
+template <> struct Libmvec<ISA::AVX2> {
+  static constexpr size_t Width = 4;
+  __attribute__((target("avx2,fma"))) static void Sqrt(double const *x,
+                                                       double *Res) {
+    _mm256_storeu_pd(Res, _mm256_sqrt_pd(_mm256_loadu_pd(x)));
+  }
+  __attribute__((target("avx2,fma"))) static void Exp(double const *x,
+                                                      double *Res) {
+    _mm256_storeu_pd(Res, _ZGVdN4v_exp(_mm256_loadu_pd(x)));
+  }
+  __attribute__((target("avx2,fma"))) static void Log(double const *x,
+                                                      double *Res) {
+    _mm256_storeu_pd(Res, _ZGVdN4v_log(_mm256_loadu_pd(x)));
+  }
+  __attribute__((target("avx2,fma"))) static void Sin(double const *x,
+                                                      double *Res) {
+    _mm256_storeu_pd(Res, _ZGVdN4v_sin(_mm256_loadu_pd(x)));
+  }
+  __attribute__((target("avx2,fma"))) static void Cos(double const *x,
+                                                      double *Res) {
+    _mm256_storeu_pd(Res, _ZGVdN4v_cos(_mm256_loadu_pd(x)));
+  }
+  __attribute__((target("avx2,fma"))) static void
+  Pow(double const *x, double const *y, double *Res) {
+    _mm256_storeu_pd(Res,
+                     _ZGVdN4vv_pow(_mm256_loadu_pd(x), _mm256_loadu_pd(y)));
+  }
+};
+
+template <> struct Libmvec<ISA::AVX512> {
+  static constexpr size_t Width = 8;
+  __attribute__((target("avx512f"))) static void Sqrt(double const *x,
+                                                      double *Res) {
+    _mm512_storeu_pd(Res, _mm512_maskz_sqrt_pd(0xFF, _mm512_loadu_pd(x)));
+  }
+  __attribute__((target("avx512f"))) static void Exp(double const *x,
+                                                     double *Res) {
+    _mm512_storeu_pd(Res, _ZGVeN8v_exp(_mm512_loadu_pd(x)));
+  }
+  __attribute__((target("avx512f"))) static void Log(double const *x,
+                                                     double *Res) {
+    _mm512_storeu_pd(Res, _ZGVeN8v_log(_mm512_loadu_pd(x)));
+  }
+  __attribute__((target("avx512f"))) static void Sin(double const *x,
+                                                     double *Res) {
+    _mm512_storeu_pd(Res, _ZGVeN8v_sin(_mm512_loadu_pd(x)));
+  }
+  __attribute__((target("avx512f"))) static void Cos(double const *x,
+                                                     double *Res) {
+    _mm512_storeu_pd(Res, _ZGVeN8v_cos(_mm512_loadu_pd(x)));
+  }
+  __attribute__((target("avx512f"))) static void
+  Pow(double const *x, double const *y, double *Res) {
+    _mm512_storeu_pd(Res,
+                     _ZGVeN8vv_pow(_mm512_loadu_pd(x), _mm512_loadu_pd(y)));
+  }
+};
+
+enum BinaryOpcode { FAdd, FSub, FMul, FDiv };
+
+// Must be inlined to be compiled for the caller's instruction set
+template <BinaryOpcode Opcode, typename T>
+__attribute__((always_inline)) inline T Apply(T a, T b) {
+  if constexpr (Opcode == FAdd)
+    return a + b;
+  else if constexpr (Opcode == FSub)
+    return a - b;
+  else if constexpr (Opcode == FMul)
+    return a * b;
+  else
+    return a / b;
+}
+
+template <typename T> T Apply(BinaryOpcode Opcode, T a, T b) {
+  switch (Opcode) {
+  case FAdd:
+    return Apply<FAdd>(a, b);
+  case FSub:
+    return Apply<FSub>(a, b);
+  case FMul:
+    return Apply<FMul>(a, b);
+  default:
+    return Apply<FDiv>(a, b);
+  }
+}
+
+// Kernels are structs with an always_inline static Run() method, so that the
+// same code is compiled once per instruction set
+template <typename Kernel, typename... Args>
+__attribute__((target("avx512f"))) auto RunAVX512(Args... Arguments) {
+  return Kernel::Run(Arguments...);
+}
+
+template <typename Kernel, typename... Args>
+__attribute__((target("avx2,fma"))) auto RunAVX2(Args... Arguments) {
+  return Kernel::Run(Arguments...);
+}
+
+template <typename Kernel, typename... Args>
+__attribute__((target("sse4.2"))) auto RunSSE42(Args... Arguments) {
+  return Kernel::Run(Arguments...);
+}
+
+// Runs Kernel with the instruction set selected at initialization
+// Vectors must not be passed as arguments, since their ABI depends on the
+// instruction set
+template <typename Kernel, typename... Args>
+auto Dispatch(Args... Arguments) {
+  switch (GetISA()) {
+  case ISA::AVX512:
+    return RunAVX512<Kernel>(Arguments...);
+  case ISA::AVX2:
+    return RunAVX2<Kernel>(Arguments...);
+  case ISA::SSE42:
+    return RunSSE42<Kernel>(Arguments...);
+  default:
+    return Kernel::Run(Arguments...);
+  }
+}
+
+// Ranges of shadows larger than this are written with non-temporal stores,
+// they would evict the working set from the caches anyway
+constexpr size_t StreamingThreshold = size_t(4) << 20;
+
+// Copies Bytes to Dest with non-temporal stores, that bypass the caches
+// Dest and Source must not overlap, and a StreamFence() is required before
+// other threads read Dest
+inline void StreamCopy(void *Dest, void const *Source, size_t Bytes) {
+  auto *Out = static_cast<char *>(Dest);
+  auto *In = static_cast<char const *>(Source);
+
+  // Non-temporal stores must be aligned
+  size_t Head = std::min(Bytes, (-reinterpret_cast<uintptr_t>(Out)) & 31);
+  std::memcpy(Out, In, Head);
+  Out += Head;
+  In += Head;
+  Bytes -= Head;
+
+#ifdef __AVX__
+  for (; Bytes >= 32; Out += 32, In += 32, Bytes -= 32) {
+    __m256i Chunk = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(In));
+    _mm256_stream_si256(reinterpret_cast<__m256i *>(Out), Chunk);
+  }
+#else
+  for (; Bytes >= 16; Out += 16, In += 16, Bytes -= 16) {
+    __m128i Chunk = _mm_loadu_si128(reinterpret_cast<__m128i const *>(In));
+    _mm_stream_si128(reinterpret_cast<__m128i *>(Out), Chunk);
+  }
+#endif
+  std::memcpy(Out, In, Bytes);
+}
+
+inline void StreamFence() { _mm_sfence(); }
+
+// Fills the shadows of Count values with Fill(Source, Res, Count)
+// Large ranges are filled through a cache resident buffer, which is streamed
+// to the shadow memory
+template <typename ShadowT, typename ScalarT, typename FillT>
+void FillRange(ScalarT const *Source, ShadowT *Res, size_t Count, FillT Fill) {
+  if (Count * sizeof(ShadowT) < StreamingThreshold)
+    return Fill(Source, Res, Count);
+
+  constexpr size_t BlockSize = 4096 / sizeof(ShadowT);
+  alignas(64) ShadowT Block[BlockSize];
+  for (size_t I = 0; I < Count; I += BlockSize) {
+    size_t Size = std::min(BlockSize, Count - I);
+    Fill(Source + I, Block, Size);
+    StreamCopy(Res + I, Block, Size * sizeof(ShadowT));
+  }
+  StreamFence();
+}
+
+} // namespace insane::simd
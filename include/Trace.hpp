@@ -0,0 +1,359 @@
+/**
+ * @file Trace.hpp
+ * @brief Binary trace of the operations reaching the interface.
+ * @version 0.1.0
+ *
+ * With trace=true, every generated entry point appends a record of its call to
+ * a log of the calling thread, before running the backend. A trace captured
+ * with a cheap backend, like DoublePrec, is replayed offline against any
+ * other with insane-replay, see Replay.hpp. Calls are recorded whether or not
+ * their checks run, regions and callsite filters are left to the replay.
+ *
+ * Each thread writes a set of segment files named
+ * <trace_prefix>.<pid>.<thread>.<segment>.trace, memory-mapped and
+ * trace_segment_size MiB large. With trace_segments=N, only the last N
+ * segments of a thread are kept. Segments are self-contained, a file starts
+ * with a TraceFileHeader followed by the records:
+ *
+ *   uint16_t Entry     Index of the entry point in the interface, plus one
+ *   uint16_t Size      Size of the payload in bytes
+ *   payload            Callsite, then the parameters in signature order
+ *
+ * In the payload, addresses (callsites and shadows) are zigzag varints of the
+ * difference with the previous address of the same kind in the segment, and
+ * sizes are varints. Floating point values are split in scalars, long doubles
+ * in two words, each written as the varint of its XOR with the previous value
+ * at the same callsite and position in the record. Values repeated or close
+ * to the previous ones then take a few bytes. make_shadow_range records hold
+ * the shadow, the count and then the values, XORed with the previous value of
+ * the range, and are split in ranges of at most TraceRangeChunk values.
+ *
+ * Segments of a thread that did not exit cleanly have a zero Size in their
+ * header, and end at the first zero Entry.
+ *
+ * With an inline backend, entries other than checks and comparisons may be
+ * inlined, their records then hold the return address of the instrumented
+ * function instead of the callsite.
+ */
+
+#pragma once
+#include "Flags.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace insane {
+
+// Bytes at the start of a segment file
+struct TraceFileHeader {
+  static constexpr char MagicValue[8] = {'I', 'N', 'S', 'T',
+                                         'R', 'A', 'C', 'E'};
+  static constexpr uint32_t CurrentVersion = 2;
+
+  char Magic[8];
+  uint32_t Version;
+  // Of the traced program, gives the distance between contiguous shadows
+  uint32_t ShadowScale;
+  // Of the interface generated for the traced program, see InterfaceHash in
+  // InterfaceGenerator.py. Entry indices are only meaningful for this hash
+  uint64_t InterfaceHash;
+  uint32_t Process;
+  uint32_t Thread;
+  uint32_t Segment;
+  uint32_t Reserved;
+  // Bytes of records following the header, 0 until the segment is closed
+  uint64_t Size;
+  uint64_t Records;
+};
+
+struct TraceRecordHeader {
+  uint16_t Entry;
+  uint16_t Size;
+};
+
+constexpr size_t TraceMaxPayload = UINT16_MAX;
+constexpr size_t TraceMaxRecord = sizeof(TraceRecordHeader) + TraceMaxPayload;
+constexpr size_t TraceRangeChunk = 1024;
+// Previous values by callsite and position, hashed and reset in each segment
+constexpr size_t TraceValueSlots = 4096;
+
+// Set at initialization only
+inline bool TraceEnabled = false;
+inline uint32_t TraceShadowScale = 1;
+
+// Defined by the generated interface
+extern uint64_t const TraceInterfaceHash __attribute__((weak));
+
+/**
+ * @brief Opens the trace from the trace flags
+ *
+ * @param Flags
+ */
+void ConfigureTrace(RuntimeFlags const &Flags);
+
+/**
+ * @brief Closes the current segment of the calling thread
+ *
+ * Threads close their segment when they exit, the next record opens a new
+ * one.
+ */
+void CloseThreadTrace();
+
+// Write position in the current segment of a thread
+struct TraceCursor {
+  char *Position;
+  char *End;
+  uintptr_t LastCallsite;
+  uintptr_t LastShadow;
+  uint64_t Records;
+  uint64_t *LastValues;
+};
+
+// Cursor of the calling thread, with at least TraceMaxRecord bytes left
+TraceCursor &ReserveTraceRecord();
+
+inline char *PutVarint(char *Out, uint64_t Value) {
+  while (Value >= 0x80) {
+    *Out++ = static_cast<char>(Value | 0x80);
+    Value >>= 7;
+  }
+  *Out++ = static_cast<char>(Value);
+  return Out;
+}
+
+inline uint64_t ZigZag(int64_t Value) {
+  return (static_cast<uint64_t>(Value) << 1) ^
+         static_cast<uint64_t>(Value >> 63);
+}
+
+inline int64_t UnZigZag(uint64_t Value) {
+  return static_cast<int64_t>(Value >> 1) ^ -static_cast<int64_t>(Value & 1);
+}
+
+// Bytes of a traced value, long doubles only have 10 significant ones
+template <typename T> constexpr size_t TraceValueSize() {
+  if constexpr (std::is_same_v<T, long double>)
+    return 10;
+  return sizeof(T);
+}
+
+// Bytes XORed at once, the scalars of vectors
+template <typename T> constexpr size_t TraceWordSize() {
+  if constexpr (std::is_arithmetic_v<T>)
+    return std::min(sizeof(T), sizeof(uint64_t));
+  else
+    return sizeof(std::declval<T>()[0]);
+}
+
+inline uint64_t &TraceLastValue(uint64_t *LastValues, uintptr_t Callsite,
+                                size_t Word) {
+  uint64_t Hash = (Callsite * 0x9E3779B97F4A7C15ull) >> 40;
+  return LastValues[(Hash ^ Word) % TraceValueSlots];
+}
+
+/**
+ * @brief Record of one call of an entry point, written in place in the segment
+ * and committed by the destructor
+ *
+ * Parameters are added in the order of the signature.
+ */
+class TraceRecord {
+public:
+  TraceRecord(uint16_t Entry, void const *Callsite)
+      : Cursor(ReserveTraceRecord()),
+        Callsite(reinterpret_cast<uintptr_t>(Callsite)), Entry(Entry + 1) {
+    Position = Cursor.Position + sizeof(TraceRecordHeader);
+    Address(Callsite, Cursor.LastCallsite);
+  }
+
+  TraceRecord(TraceRecord const &other) = delete;
+  TraceRecord &operator=(TraceRecord const &other) = delete;
+
+  ~TraceRecord() {
+    TraceRecordHeader Header = {
+        Entry, static_cast<uint16_t>(Position - Cursor.Position -
+                                     sizeof(TraceRecordHeader))};
+    std::memcpy(Cursor.Position, &Header, sizeof(Header));
+    Cursor.Position = Position;
+    Cursor.Records++;
+  }
+
+  template <typename T> void Value(T const &Value) {
+    char const *Bytes = reinterpret_cast<char const *>(&Value);
+    for (size_t Offset = 0; Offset < TraceValueSize<T>();
+         Offset += TraceWordSize<T>()) {
+      uint64_t Word = 0;
+      std::memcpy(&Word, Bytes + Offset,
+                  std::min(TraceWordSize<T>(), TraceValueSize<T>() - Offset));
+      uint64_t &Last = TraceLastValue(Cursor.LastValues, Callsite, NextWord++);
+      Position = PutVarint(Position, Word ^ Last);
+      Last = Word;
+    }
+  }
+
+  // Values of an array share their position, each is XORed with the previous
+  template <typename T> void Values(T const *Values, size_t Count) {
+    size_t First = NextWord;
+    for (size_t I = 0; I < Count; I++) {
+      NextWord = First;
+      Value(Values[I]);
+    }
+  }
+
+  void Shadow(void const *Shadow) { Address(Shadow, Cursor.LastShadow); }
+
+  // Lane shadows of a vector
+  template <typename T> void Shadows(T *const *Shadows, size_t Count) {
+    for (size_t I = 0; I < Count; I++)
+      Shadow(Shadows[I]);
+  }
+
+  void Size(uint64_t Size) { Position = PutVarint(Position, Size); }
+
+private:
+  void Address(void const *Address, uintptr_t &Last) {
+    auto Value = reinterpret_cast<uintptr_t>(Address);
+    Position = PutVarint(Position, ZigZag(Value - Last));
+    Last = Value;
+  }
+
+  TraceCursor &Cursor;
+  char *Position;
+  uintptr_t Callsite;
+  size_t NextWord = 0;
+  uint16_t Entry;
+};
+
+/**
+ * @brief Records a make_shadow_range call
+ *
+ * @param Entry Index of the entry point
+ * @param Callsite
+ * @param Values Values of the range
+ * @param Shadow Shadow of Values[0]
+ * @param Count
+ */
+template <typename T>
+void TraceShadowRange(uint16_t Entry, void const *Callsite, T const *Values,
+                      void const *Shadow, size_t Count) {
+  size_t Stride = sizeof(T) * TraceShadowScale;
+  for (size_t Done = 0; Done < Count; Done += TraceRangeChunk) {
+    size_t Chunk = std::min(Count - Done, TraceRangeChunk);
+    TraceRecord Record(Entry, Callsite);
+    Record.Shadow(static_cast<char const *>(Shadow) + Done * Stride);
+    Record.Size(Chunk);
+    Record.Values(Values + Done, Chunk);
+  }
+}
+
+/**
+ * @brief Reads back the parameters of a record, in the order they were written
+ *
+ * Values are decoded from the previous ones, records must be read in full and
+ * in order.
+ */
+class TracePayloadReader {
+public:
+  TracePayloadReader() = default;
+  TracePayloadReader(char const *Data, uintptr_t &LastShadow,
+                     uint64_t *LastValues)
+      : Data(Data), LastShadow(&LastShadow), LastValues(LastValues) {}
+
+  // Read first, values are decoded from the previous ones of the callsite
+  uintptr_t Callsite(uintptr_t &LastCallsite) {
+    CurrentCallsite = Address(LastCallsite);
+    return CurrentCallsite;
+  }
+
+  // Vectors are not returned by value, their ABI depends on the target
+  template <typename T> void Value(T &Value) {
+    char *Bytes = reinterpret_cast<char *>(&Value);
+    for (size_t Offset = 0; Offset < TraceValueSize<T>();
+         Offset += TraceWordSize<T>()) {
+      uint64_t &Last = TraceLastValue(LastValues, CurrentCallsite, NextWord++);
+      Last ^= Size();
+      std::memcpy(Bytes + Offset, &Last,
+                  std::min(TraceWordSize<T>(), TraceValueSize<T>() - Offset));
+    }
+  }
+
+  template <typename T> void Values(T *Values, size_t Count) {
+    size_t First = NextWord;
+    for (size_t I = 0; I < Count; I++) {
+      NextWord = First;
+      Value(Values[I]);
+    }
+  }
+
+  uintptr_t Shadow() { return Address(*LastShadow); }
+
+  uintptr_t Address(uintptr_t &Last) {
+    Last += UnZigZag(Size());
+    return Last;
+  }
+
+  uint64_t Size() {
+    uint64_t Value = 0;
+    for (unsigned Shift = 0;; Shift += 7) {
+      auto Byte = static_cast<uint8_t>(*Data++);
+      Value |= static_cast<uint64_t>(Byte & 0x7f) << Shift;
+      if (Byte < 0x80)
+        return Value;
+    }
+  }
+
+private:
+  char const *Data = nullptr;
+  uintptr_t *LastShadow = nullptr;
+  uint64_t *LastValues = nullptr;
+  uintptr_t CurrentCallsite = 0;
+  size_t NextWord = 0;
+};
+
+/**
+ * @brief Iterates over the records of a segment file
+ *
+ */
+class TraceReader {
+public:
+  /**
+   * @brief Maps a segment file
+   *
+   * @param Path
+   * @param Error Set to the reason the segment cannot be read, if any
+   */
+  TraceReader(std::string const &Path, std::string &Error);
+  ~TraceReader();
+
+  TraceReader(TraceReader const &other) = delete;
+  TraceReader &operator=(TraceReader const &other) = delete;
+
+  bool valid() const { return Data != nullptr; }
+  TraceFileHeader const &header() const { return Header; }
+
+  /**
+   * @brief Moves to the next record
+   *
+   * @param Entry Index of its entry point
+   * @param Callsite Return address of the entry point
+   * @param Payload Set to the reader of its parameters
+   * @return false at the end of the segment
+   */
+  bool Next(uint16_t &Entry, uintptr_t &Callsite, TracePayloadReader &Payload);
+
+private:
+  TraceFileHeader Header;
+  char const *Data = nullptr;
+  size_t MappedSize = 0;
+  char const *Position = nullptr;
+  char const *End = nullptr;
+  uintptr_t LastCallsite = 0;
+  uintptr_t LastShadow = 0;
+  uint64_t LastValues[TraceValueSlots] = {};
+};
+
+} // namespace insane
@@ -10,9 +10,12 @@
 #pragma once
 
 #include <cmath>
+#include <cstdint>
+#include <ctime>
 #include <iostream>
 #include <limits>
 #include <random>
+#include <type_traits>
 
 namespace std {
 
@@ -34,6 +37,7 @@ typedef double v4double __attribute__((vector_size(32)));
 typedef double v8double __attribute__((vector_size(64)));
 typedef long double v2ldouble __attribute__((vector_size(32)));
 typedef long double v4ldouble __attribute__((vector_size(64)));
+typedef int64_t v4int64 __attribute__((vector_size(32)));
 
 typedef __int128 int128_t;
 typedef unsigned __int128 uint128_t;
@@ -79,23 +83,115 @@ void PrintStackTrace(uint32_t StackId) noexcept;
 [[noreturn]] void unreachable(const char *str) noexcept;
 [[noreturn]] void exit(int status) noexcept;
 
+// xoshiro256++ generator, see https://prng.di.unimi.it/
+// Much cheaper than std::default_random_engine, with a 2^256 - 1 period
+class Xoshiro256pp {
+public:
+  constexpr Xoshiro256pp() = default;
+
+  // The state is expanded from the seed with splitmix64, as recommended
+  void seed(uint64_t Seed) noexcept {
+    for (uint64_t &Word : State) {
+      uint64_t Z = (Seed += 0x9e3779b97f4a7c15);
+      Z = (Z ^ (Z >> 30)) * 0xbf58476d1ce4e5b9;
+      Z = (Z ^ (Z >> 27)) * 0x94d049bb133111eb;
+      Word = Z ^ (Z >> 31);
+    }
+  }
+
+  uint64_t operator()() noexcept {
+    uint64_t Res = rotl(State[0] + State[3], 23) + State[0];
+    uint64_t T = State[1] << 17;
+    State[2] ^= State[0];
+    State[3] ^= State[1];
+    State[1] ^= State[2];
+    State[0] ^= State[3];
+    State[2] ^= T;
+    State[3] = rotl(State[3], 45);
+    return Res;
+  }
+
+private:
+  static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+  uint64_t State[4] = {0, 0, 0, 0};
+};
+
+// Per-thread buffer of random words, refilled in bulk
+// Also keeps a bit budget, so that a single word can serve multiple draws of a
+// few bits
+class RandomPool {
+public:
+  static constexpr size_t PoolSize = 64;
+
+  // Constant initialization, so that thread_local accesses need no guard
+  constexpr RandomPool() = default;
+
+  // UniformRandomBitGenerator requirements
+  using result_type = uint64_t;
+  static constexpr uint64_t min() { return 0; }
+  static constexpr uint64_t max() { return UINT64_MAX; }
+  uint64_t operator()() noexcept { return next(); }
+
+  uint64_t next() noexcept {
+    if (Index == 0)
+      refill();
+    return Pool[--Index];
+  }
+
+  // Returns a signed integer made of Bits random bits, that is in
+  // [-2^(Bits-1), 2^(Bits-1)). Same as (int64_t)next() >> (64 - Bits)
+  template <unsigned Bits> int64_t bits() noexcept {
+    static_assert(Bits > 0 && Bits <= 64, "Invalid number of random bits");
+    if (Available < Bits) {
+      Reservoir = next();
+      Available = 64;
+    }
+    int64_t Res = static_cast<int64_t>(Reservoir << (64 - Bits)) >> (64 - Bits);
+    // Shifting an uint64_t by 64 is undefined
+    Reservoir = (Bits == 64) ? 0 : Reservoir >> (Bits % 64);
+    Available -= Bits;
+    return Res;
+  }
+
+private:
+  // Cold path, the generator is seeded on first use
+  void refill() noexcept {
+    if (not Seeded) {
+      std::random_device Device;
+      Generator.seed((uint64_t(Device()) << 32) ^ Device() ^
+                     reinterpret_cast<uintptr_t>(this) ^ time(nullptr));
+      Seeded = true;
+    }
+    for (size_t I = 0; I < PoolSize; I++)
+      Pool[I] = Generator();
+    Index = PoolSize;
+  }
+
+  uint64_t Pool[PoolSize] = {};
+  size_t Index = 0;
+  uint64_t Reservoir = 0;
+  unsigned Available = 0;
+  bool Seeded = false;
+  Xoshiro256pp Generator;
+};
+
+// Each thread has its own pool to prevent concurrency
+inline thread_local RandomPool ThreadRandomPool;
+
 // Return an integer between [LowerBound; Upperbound] included
 // By default between [T::min; T::max]
 // Thread safe
 template <typename T> T rand() {
-  // We dont need the same distribution for int and float
-  using uniform_distribution =
-      typename std::conditional<std::is_integral<T>::value,
-                                std::uniform_int_distribution<T>,
-                                std::uniform_real_distribution<T>>::type;
-  // Implementation dependant, generally quite heavy
-  // thread_local to prevent concurrency
-  static thread_local std::default_random_engine RandomGenerator(time(nullptr));
-
-  // Lightweight object
-  uniform_distribution distribution(std::numeric_limits<T>::min(),
-                                    std::numeric_limits<T>::max());
-  return distribution(RandomGenerator);
+  if constexpr (std::is_integral<T>::value) {
+    // Truncating a uniform 64 bits word keeps a uniform distribution
+    static_assert(sizeof(T) <= sizeof(uint64_t), "Unsupported integer type");
+    return static_cast<T>(ThreadRandomPool.next());
+  } else {
+    std::uniform_real_distribution<T> distribution(
+        std::numeric_limits<T>::min(), std::numeric_limits<T>::max());
+    return distribution(ThreadRandomPool);
+  }
 }
 
 // std:: does not natively support 128 bits types
@@ -117,9 +213,28 @@ template <> inline __int128_t rand<__int128_t>() {
   return (Left64 << 64) | Right64;
 }
 
+// Returns Bits random bits, sign extended. Cheaper than rand<int64_t>() when
+// only a few bits are needed
+// Thread safe
+template <unsigned Bits> int64_t randbits() {
+  return ThreadRandomPool.bits<Bits>();
+}
+
 // std::abs and std::isnan do not natively support __float128
 template <typename T> T abs(T x) { return (x < 0) ? -x : x; }
 
+// std::fma does not support GCC vectors, their lanes are fused one by one
+template <typename T> T fma(T a, T b, T c) {
+  if constexpr (std::is_floating_point_v<T>)
+    return std::fma(a, b, c);
+  else {
+    T Res;
+    for (size_t I = 0; I < sizeof(T) / sizeof(a[0]); I++)
+      Res[I] = std::fma(a[I], b[I], c[I]);
+    return Res;
+  }
+}
+
 // Required to check for unordered comparisons
 template <typename T> bool isnan(T x) { return std::isnan(x); }
 
@@ -0,0 +1,178 @@
+/**
+ * @file WarningLog.hpp
+ * @brief Asynchronous emission of the backends warnings.
+ * @version 0.1.0
+ *
+ *
+ */
+
+#pragma once
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_set>
+
+namespace insane {
+
+/**
+ * @brief Raw values of a warning, formatted later by the writer thread
+ *
+ * Values are copied bytewise, the formatter must read them back in the same
+ * order and with the same types.
+ */
+class WarningPayload {
+public:
+  static constexpr size_t MaxSize = 2048;
+
+  template <typename T> void put(T const &Value) { put(&Value, 1); }
+
+  template <typename T> void put(T const *Values, size_t Count) {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "Warning values are copied bytewise");
+    assert(Size + sizeof(T) * Count <= MaxSize);
+    std::memcpy(Data + Size, Values, sizeof(T) * Count);
+    Size += sizeof(T) * Count;
+  }
+
+  char const *data() const { return Data; }
+  size_t size() const { return Size; }
+
+private:
+  size_t Size = 0;
+  char Data[MaxSize];
+};
+
+class WarningPayloadReader {
+public:
+  explicit WarningPayloadReader(char const *Data) : Data(Data) {}
+
+  // Copies to an aligned value, since the payload is packed
+  template <typename T> T get() {
+    T Value;
+    std::memcpy(&Value, Data, sizeof(T));
+    Data += sizeof(T);
+    return Value;
+  }
+
+private:
+  char const *Data;
+};
+
+/**
+ * @brief Formats the payload of a warning
+ *
+ * Formatters are instantiated per backend, type and vector size, so the
+ * formatter pointer also acts as the type tag of the record.
+ */
+using WarningFormatter = void (*)(WarningPayloadReader &Payload,
+                                  std::ostream &Out);
+
+/**
+ * @brief Emits the warnings of the backends
+ *
+ * The warning hot path only copies a compact binary record (formatter, stack
+ * id and payload) to a per-thread ring. A background writer thread formats
+ * the records and writes them to stderr in large batches. Records of a thread
+ * are emitted in order, records of different threads may interleave.
+ *
+ * Each stacktrace is printed with its first warning only, since nsan prints
+ * it directly and would split the batches.
+ *
+ * With async_warnings=false, records are formatted and written on the calling
+ * thread instead.
+ */
+class WarningLog {
+public:
+  static WarningLog &getInstance();
+
+  WarningLog(WarningLog const &other) = delete;
+  WarningLog &operator=(WarningLog const &other) = delete;
+
+  /**
+   * @brief Flushes every pending record and stops the writer thread
+   *
+   */
+  ~WarningLog();
+
+  /**
+   * @brief Records a warning, the current stacktrace and region
+   *
+   * Blocks if the ring of the current thread is full, warnings are never
+   * dropped.
+   *
+   * @param Format Formatter of the payload
+   * @param Payload
+   */
+  void Push(WarningFormatter Format, WarningPayload const &Payload);
+
+  /**
+   * @brief Writes every pending record. Called before exiting on error
+   *
+   */
+  void Flush();
+
+  // Header of a record in a ring, followed by the payload
+  struct RecordHeader {
+    WarningFormatter Format;
+    uint32_t StackId;
+    uint32_t Size;
+    // Region of interest of the warning, 0 outside of any region
+    uint32_t Region;
+  };
+
+  // Single producer, single consumer ring of records
+  // Only drained with RingsMutex held
+  struct Ring {
+    static constexpr size_t Capacity = size_t(1) << 16;
+
+    // Bytes written by the owner thread, and read by the writer
+    std::atomic<size_t> Head{0};
+    std::atomic<size_t> Tail{0};
+
+    Ring *Next = nullptr;
+    Ring *Prev = nullptr;
+
+    char Data[Capacity];
+
+    void CopyIn(size_t Pos, void const *Src, size_t Size);
+    void CopyOut(size_t Pos, void *Dest, size_t Size) const;
+  };
+
+private:
+  WarningLog() = default;
+
+  Ring &LocalRing();
+  void Unregister(Ring &Source);
+
+  // Writer thread main loop
+  void Run();
+
+  // Must be called with RingsMutex held
+  bool Drain(Ring &Source);
+  void Emit(RecordHeader const &Header, char const *Payload);
+  void WriteBatch();
+
+  std::once_flag WriterStarted;
+  std::thread Writer;
+  std::atomic<bool> Stopping{false};
+  std::mutex WaitMutex;
+  std::condition_variable WakeUp;
+
+  std::mutex RingsMutex;
+  Ring *Rings = nullptr;
+  // Formatted text not yet written, only used with RingsMutex held
+  std::string Batch;
+  // Stacktraces already printed, only used with RingsMutex held
+  std::unordered_set<uint32_t> PrintedStacks;
+
+  friend struct RingHandle;
+};
+
+} // namespace insane
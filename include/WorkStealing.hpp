@@ -0,0 +1,147 @@
+/**
+ * @file WorkStealing.hpp
+ * @brief Work-stealing thread pool used by the offline replay.
+ * @version 0.1.0
+ *
+ *
+ */
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace insane {
+
+/**
+ * @brief Runs tasks of uneven lengths on a fixed set of workers
+ *
+ * Each worker owns a queue. It runs its own tasks from the most recently
+ * submitted, and once its queue is empty, steals the oldest task of the other
+ * queues. Tasks submitted before Run are spread over the queues, tasks
+ * submitted by a running task go to the queue of its worker. Workers without
+ * tasks sleep until one is submitted or every task is done.
+ */
+class WorkStealingPool {
+public:
+  using Task = std::function<void()>;
+
+  explicit WorkStealingPool(unsigned Workers)
+      : Queues(std::max(Workers, 1u)) {}
+
+  WorkStealingPool(WorkStealingPool const &other) = delete;
+  WorkStealingPool &operator=(WorkStealingPool const &other) = delete;
+
+  size_t workers() const { return Queues.size(); }
+
+  void Submit(Task NewTask) {
+    size_t Index = (CurrentPool == this)
+                       ? CurrentWorker
+                       : NextQueue.fetch_add(1, std::memory_order_relaxed) %
+                             Queues.size();
+    Pending.fetch_add(1, std::memory_order_relaxed);
+    {
+      std::scoped_lock<std::mutex> lock(Queues[Index].Mutex);
+      Queues[Index].Tasks.push_back(std::move(NewTask));
+      Queued.fetch_add(1, std::memory_order_relaxed);
+    }
+    Wake(false);
+  }
+
+  /**
+   * @brief Runs every task, including the ones submitted meanwhile, on the
+   * calling thread and workers() - 1 others
+   *
+   */
+  void Run() {
+    std::vector<std::thread> Threads;
+    for (size_t I = 1; I < Queues.size(); I++)
+      Threads.emplace_back([this, I] { Work(I); });
+    Work(0);
+    for (std::thread &Thread : Threads)
+      Thread.join();
+  }
+
+private:
+  struct Queue {
+    std::mutex Mutex;
+    std::deque<Task> Tasks;
+  };
+
+  bool Take(size_t Self, Task &Out) {
+    {
+      Queue &Own = Queues[Self];
+      std::scoped_lock<std::mutex> lock(Own.Mutex);
+      if (not Own.Tasks.empty()) {
+        Out = std::move(Own.Tasks.back());
+        Own.Tasks.pop_back();
+        Queued.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+    for (size_t I = 1; I < Queues.size(); I++) {
+      Queue &Victim = Queues[(Self + I) % Queues.size()];
+      std::scoped_lock<std::mutex> lock(Victim.Mutex);
+      if (not Victim.Tasks.empty()) {
+        Out = std::move(Victim.Tasks.front());
+        Victim.Tasks.pop_front();
+        Queued.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Taking the lock orders the change of the counters before the wait
+  // predicate of the sleeping workers
+  void Wake(bool All) {
+    { std::scoped_lock<std::mutex> lock(IdleMutex); }
+    if (All)
+      Idle.notify_all();
+    else
+      Idle.notify_one();
+  }
+
+  // A task is only done once it returned, so that the tasks it submits keep
+  // the workers running
+  void Work(size_t Self) {
+    CurrentPool = this;
+    CurrentWorker = Self;
+    Task Current;
+    while (true) {
+      if (Take(Self, Current)) {
+        Current();
+        Current = nullptr;
+        if (Pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+          Wake(true);
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(IdleMutex);
+      Idle.wait(lock, [this] {
+        return Pending.load(std::memory_order_acquire) == 0 ||
+               Queued.load(std::memory_order_relaxed) > 0;
+      });
+      if (Pending.load(std::memory_order_acquire) == 0)
+        break;
+    }
+    CurrentPool = nullptr;
+  }
+
+  std::vector<Queue> Queues;
+  // Submitted tasks not done yet, and the ones still in a queue
+  std::atomic<size_t> Pending{0};
+  std::atomic<size_t> Queued{0};
+  std::atomic<size_t> NextQueue{0};
+  std::mutex IdleMutex;
+  std::condition_variable Idle;
+
+  static inline thread_local WorkStealingPool *CurrentPool = nullptr;
+  static inline thread_local size_t CurrentWorker = 0;
+};
+
+} // namespace insane
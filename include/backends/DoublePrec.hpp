@@ -9,6 +9,7 @@
 
 #pragma once
 #include "Backend.hpp"
+#include "DoubleDouble.hpp"
 #include "Flags.hpp"
 #include "OpaqueShadow.hpp"
 #include "Utils.hpp"
@@ -24,8 +25,16 @@ struct DoublePrecShadow {
   double val;
 };
 
+// Double-double is much faster than the software emulated __float128, but
+// has 106 bits of mantissa instead of 113, and the exponent range of a double
+#ifdef INSANE_DOUBLEPREC_DOUBLE_DOUBLE
+using LargeShadowScalar = DoubleDouble;
+#else
+using LargeShadowScalar = __float128;
+#endif
+
 struct DoublePrecLargeShadow {
-  __float128 val;
+  LargeShadowScalar val;
 };
 
 static_assert(sizeof(DoublePrecShadow) == 8, "invalid DoublePrec shadow size");
@@ -0,0 +1,725 @@
+/**
+ * @file DoublePrecImpl.hpp
+ * @author Mathys JAM (mathys.jam@ens.uvsq.fr)
+ * @brief Template definitions of the double precision backend
+ *
+ * Included by DoublePrec.cpp, and by the generated interface in inline builds
+ * so that the backend can be inlined into the instrumented code with LTO
+ * @version 9.1.0
+ *
+ *
+ */
+
+#pragma once
+#include "Context.hpp"
+#include "Region.hpp"
+#include "Simd.hpp"
+#include "WarningLog.hpp"
+#include "backends/DoublePrec.hpp"
+#include <cstring>
+
+namespace insane {
+
+// Helper methods
+namespace doubleprec {
+
+// Compares the double shadows of a float vector on every lane at once, true if
+// Opcode holds on every lane
+template <FCmpOpcode Opcode, size_t VectorSize> struct FCmpKernel {
+  static __attribute__((always_inline)) bool
+  Run(DoublePrecShadow const *LeftShadow, DoublePrecShadow const *RightShadow) {
+    using ExtendedVector = simd::Vector_t<double, VectorSize>;
+    static_assert(sizeof(ExtendedVector) ==
+                  VectorSize * sizeof(DoublePrecShadow));
+
+    ExtendedVector Left, Right;
+    std::memcpy(&Left, LeftShadow, sizeof(ExtendedVector));
+    std::memcpy(&Right, RightShadow, sizeof(ExtendedVector));
+    return ReduceFCmp<Opcode>(Left, Right);
+  }
+};
+
+// Performs the comparison in the shadow space, large shadows lane by lane
+template <FCmpOpcode Opcode, size_t VectorSize, typename DoublePrecShadowT>
+bool FCmp(DoublePrecShadowT *LeftShadow, DoublePrecShadowT *RightShadow) {
+  if constexpr (VectorSize > 1 &&
+                std::is_same_v<DoublePrecShadowT, DoublePrecShadow>)
+    return simd::Dispatch<FCmpKernel<Opcode, VectorSize>>(LeftShadow,
+                                                          RightShadow);
+  else {
+    bool Res = true;
+    for (size_t I = 0; Res && (I < VectorSize); I++)
+      Res = ApplyFCmp<Opcode>(LeftShadow[I].val, RightShadow[I].val);
+    return Res;
+  }
+}
+
+// Formats the payload pushed by FCmpCheckFail, on the warning writer thread
+template <size_t VectorSize, typename FPType, typename DoublePrecShadow>
+void FormatFCmpCheckFail(WarningPayloadReader &Payload, std::ostream &Out) {
+  auto a = Payload.get<FPType>();
+  auto b = Payload.get<FPType>();
+
+  Out << "Shadow results depends on precision\n";
+  Out << "\tValue  a: { ";
+
+  // Avoid acessing a[I] if we're not working on vectors
+  if constexpr (VectorSize > 1) {
+    for (int I = 0; I < VectorSize; I++)
+      Out << a[I] << " ";
+    Out << "} b: ";
+    for (int I = 0; I < VectorSize; I++)
+      Out << b[I] << " ";
+  } else
+    Out << a << " } b: {" << b;
+
+  Out << "}\n\tShadow a: { ";
+  for (int I = 0; I < VectorSize; I++)
+    Out << Payload.get<DoublePrecShadow>().val << " ";
+  Out << "} b: { ";
+  for (int I = 0; I < VectorSize; I++)
+    Out << Payload.get<DoublePrecShadow>().val << " ";
+  Out << "}\n";
+}
+
+// Only copies the values, formatting is done by the warning writer thread
+template <size_t VectorSize, typename FPType, typename DoublePrecShadow>
+void FCmpCheckFail(FPType a, DoublePrecShadow *sa, FPType b,
+                   DoublePrecShadow *sb) {
+  WarningPayload Payload;
+  Payload.put(a);
+  Payload.put(b);
+  Payload.put(sa, VectorSize);
+  Payload.put(sb, VectorSize);
+  WarningLog::getInstance().Push(
+      &FormatFCmpCheckFail<VectorSize, FPType, DoublePrecShadow>, Payload);
+}
+
+template <typename ScalarVT, typename DoublePrecShadow>
+bool CheckInternal(ScalarVT Operand, DoublePrecShadow* Shadow) {
+
+  // Same as nsan default max threshold
+  // FIXME : Should be defined as flags for more versatility
+  // Note: Some compilers do not allow for constexpr math function
+  // so this was removed for compatibility purposes
+  static const double MaxAbsoluteError = 1.0 / std::pow(2, 32);
+  static const double MaxRelativeError = 1.0 / std::pow(2, 19);
+
+  // Explicit casts are required for double-double shadows
+  double AbsoluteError = static_cast<double>(utils::abs(Operand - Shadow->val));
+  double RelativeError =
+      utils::abs((AbsoluteError / static_cast<double>(Shadow->val)) * 100);
+  return AbsoluteError >= MaxAbsoluteError || RelativeError >= MaxRelativeError;
+}
+
+// CheckInternal on every lane of a float vector at once, true if any lane fails
+// The operand is passed by address, vectors cannot cross the dispatch
+template <size_t VectorSize> struct CheckLanesKernel {
+  static __attribute__((always_inline)) bool
+  Run(float const *Operand, DoublePrecShadow const *Shadow) {
+    using ExtendedVector = simd::Vector_t<double, VectorSize>;
+    constexpr double MaxAbsoluteError = 0x1p-32;
+    constexpr double MaxRelativeError = 0x1p-19;
+
+    ExtendedVector Native, Value;
+    for (size_t I = 0; I < VectorSize; I++) {
+      Native[I] = Operand[I];
+      Value[I] = Shadow[I].val;
+    }
+
+    ExtendedVector AbsoluteError = Native - Value;
+    AbsoluteError = AbsoluteError < 0 ? -AbsoluteError : AbsoluteError;
+    ExtendedVector RelativeError = (AbsoluteError / Value) * 100;
+    RelativeError = RelativeError < 0 ? -RelativeError : RelativeError;
+    return simd::Any((AbsoluteError >= MaxAbsoluteError) |
+                     (RelativeError >= MaxRelativeError));
+  }
+};
+
+// Formats the payload pushed by CheckFail, on the warning writer thread
+template <size_t VectorSize, typename FPType, typename DoublePrecShadow>
+void FormatCheckFail(WarningPayloadReader &Payload, std::ostream &Out) {
+  auto Operand = Payload.get<FPType>();
+  auto Shadow = Payload.get<DoublePrecShadow>();
+
+  Out << utils::AsciiColor::Red.str();
+  Out << "[DoublePrec] Inconsistent shadow result :" << std::setprecision(20)
+      << "\n";
+
+  Out << "\tNative Value: ";
+  // We shall not acess Operand[I] if we're not working on vectors
+  if constexpr (VectorSize > 1)
+    for (int I = 0; I < VectorSize; I++)
+      Out << Operand[I] << "\n";
+  else
+    Out << Operand << "\n";
+
+  Out << "\tShadow Value: \n\t  " << Shadow.val << "\n";
+}
+
+// Only copies the values, formatting is done by the warning writer thread
+template <size_t VectorSize, typename FPType, typename DoublePrecShadow>
+void CheckFail(FPType Operand, DoublePrecShadow *Shadow) {
+  WarningPayload Payload;
+  Payload.put(Operand);
+  Payload.put(Shadow[0]);
+  WarningLog::getInstance().Push(
+      &FormatCheckFail<VectorSize, FPType, DoublePrecShadow>, Payload);
+}
+
+template <size_t VectorSize, typename FPType, typename ShadowType,
+          typename DestType>
+void CastInternal(FPType a, ShadowType* sa, DestType **sb) {
+
+  for (int I = 0; I < VectorSize; I++) {
+    sb[I]->val = static_cast<decltype(sb[I]->val)>(sa[I].val);
+  }
+}
+
+// Since we use a fp128 type inside the shadow, we need them to be aligned
+// through a copy
+template <size_t VectorSize, typename Destination, typename Source>
+void CopyAndAlign(Destination *Dest, Source *Src) {
+
+  for (size_t I = 0; I < VectorSize; I++) {
+    memcpy(reinterpret_cast<char *>(&Dest[I]),
+           reinterpret_cast<char *>(Src[I]), sizeof(Destination));
+  }
+}
+
+// Performs Opcode on every lane of a float vector at once
+template <simd::BinaryOpcode Opcode, size_t VectorSize> struct LanesKernel {
+  static __attribute__((always_inline)) void Run(DoublePrecShadow **LeftShadow,
+                                                 DoublePrecShadow **RightShadow,
+                                                 DoublePrecShadow **Res) {
+    using ExtendedVector = simd::Vector_t<double, VectorSize>;
+
+    ExtendedVector Left, Right;
+    for (size_t I = 0; I < VectorSize; I++) {
+      Left[I] = LeftShadow[I]->val;
+      Right[I] = RightShadow[I]->val;
+    }
+
+    ExtendedVector Result = simd::Apply<Opcode>(Left, Right);
+    for (size_t I = 0; I < VectorSize; I++)
+      Res[I]->val = Result[I];
+  }
+};
+
+// Same as LanesKernel, for contiguous shadows which are loaded and stored with
+// vectors
+template <simd::BinaryOpcode Opcode, size_t VectorSize> struct BlockKernel {
+  static __attribute__((always_inline)) void
+  Run(DoublePrecShadow const *LeftShadow, DoublePrecShadow const *RightShadow,
+      DoublePrecShadow *Res) {
+    using ExtendedVector = simd::Vector_t<double, VectorSize>;
+    static_assert(sizeof(ExtendedVector) ==
+                  VectorSize * sizeof(DoublePrecShadow));
+
+    ExtendedVector Left, Right;
+    std::memcpy(&Left, LeftShadow, sizeof(ExtendedVector));
+    std::memcpy(&Right, RightShadow, sizeof(ExtendedVector));
+
+    ExtendedVector Result = simd::Apply<Opcode>(Left, Right);
+    std::memcpy(Res, &Result, sizeof(ExtendedVector));
+  }
+};
+
+// Float vector shadows are plain doubles, so they can be gathered and computed
+// with vectors. Returns false if the shadow type is not supported
+template <simd::BinaryOpcode Opcode, size_t VectorSize, typename ShadowType>
+bool BinaryKernel(ShadowType **LeftShadow, ShadowType **RightShadow,
+                  ShadowType **Res) {
+  if constexpr (VectorSize > 1 && std::is_same_v<ShadowType, OpaqueShadow>) {
+    simd::Dispatch<LanesKernel<Opcode, VectorSize>>(
+        reinterpret_cast<DoublePrecShadow **>(LeftShadow),
+        reinterpret_cast<DoublePrecShadow **>(RightShadow),
+        reinterpret_cast<DoublePrecShadow **>(Res));
+    return true;
+  }
+  return false;
+}
+
+// Double shadows are rounded once, like the native fma. Large shadows are
+// rounded twice, since libquadmath is not linked, which stays far below the
+// native precision
+template <typename T> T FusedMultiplyAdd(T a, T b, T c) {
+  if constexpr (std::is_same_v<T, double>)
+    return std::fma(a, b, c);
+  else
+    return a * b + c;
+}
+
+// Double shadows use the double libm. Large shadows use the long double one,
+// the widest available without libquadmath
+template <typename T> T ShadowMath(MathOpcode Opcode, T x, T y) {
+  if constexpr (std::is_same_v<T, double>)
+    return ApplyMath(Opcode, x, y);
+  else
+    return static_cast<T>(ApplyMath(Opcode, static_cast<long double>(x),
+                                    static_cast<long double>(y)));
+}
+
+// libgcc converts to __float128 with a generic soft-float routine, while
+// zeros and normal doubles only need their fields to be moved
+inline __float128 WidenToFloat128(double x) {
+  uint64_t Bits;
+  std::memcpy(&Bits, &x, sizeof(double));
+  uint64_t Sign = Bits & 0x8000000000000000;
+  uint64_t Exponent = (Bits >> 52) & 0x7FF;
+  uint64_t Mantissa = Bits & 0xFFFFFFFFFFFFF;
+
+  // Infinites, NaNs and subnormals
+  if (Exponent == 0x7FF || (Exponent == 0 && Mantissa != 0))
+    return x;
+  if (Exponent != 0)
+    Exponent += 16383 - 1023;
+
+  // Little endian, the low word comes first
+  uint64_t Words[2] = {Mantissa << 60,
+                       Sign | (Exponent << 48) | (Mantissa >> 4)};
+  __float128 Res;
+  std::memcpy(&Res, Words, sizeof(__float128));
+  return Res;
+}
+
+// Writes the shadows of Count values. Simple conversions are vectorized by the
+// compiler, shadows are copied since they may be unaligned
+template <typename ScalarT, typename ShadowT>
+void FillShadows(ScalarT const *Source, ShadowT *Res, size_t Count) {
+  using ValueT = decltype(Res->val);
+  for (size_t I = 0; I < Count; I++) {
+    ValueT Value;
+    if constexpr (std::is_same_v<ValueT, __float128> &&
+                  std::is_same_v<ScalarT, double>)
+      Value = WidenToFloat128(Source[I]);
+    else
+      Value = static_cast<ValueT>(Source[I]);
+    std::memcpy(&Res[I], &Value, sizeof(ShadowT));
+  }
+}
+
+} // namespace doubleprec
+
+using namespace doubleprec;
+
+// Will either be DoubleprecShadow128 or DoubleprecShadow64 depending on FPType
+template <typename ShadowType>
+using DoubleprecShadowFor =
+    typename std::conditional<std::is_same_v<OpaqueShadow, ShadowType>,
+                              DoublePrecShadow, DoublePrecLargeShadow>::type;
+
+// Unary operator overload
+template <typename MetaFloat>
+typename MetaFloat::FPType
+InsaneRuntime<MetaFloat>::Neg(FPType Operand, ShadowType **ShadowOperand,
+                              ShadowType **Res) {
+
+  using DoublePrecShadowType = DoubleprecShadowFor<ShadowType>;
+  // We align both operands
+  DoublePrecShadowType Shadow[VectorSize];
+  CopyAndAlign<VectorSize>(Shadow, ShadowOperand);
+
+  auto ResShadow = reinterpret_cast<DoubleprecShadowFor<ShadowType> **>(Res);
+
+  for (int I = 0; I < VectorSize; I++) {
+    ResShadow[I]->val = -Shadow[I].val;
+  }
+  return -Operand;
+}
+
+// Binary operator overload
+// Replicate
+template <typename MetaFloat>
+typename MetaFloat::FPType InsaneRuntime<MetaFloat>::Add(
+    FPType LeftOperand, ShadowType **LeftShadowOperand, FPType RightOperand,
+    ShadowType **const RightShadowOperand, ShadowType **Res) {
+
+  if (BinaryKernel<simd::FAdd, VectorSize>(LeftShadowOperand,
+                                            RightShadowOperand, Res))
+    return LeftOperand + RightOperand;
+
+  using DoublePrecShadowType = DoubleprecShadowFor<ShadowType>;
+  // We align both operands
+  DoublePrecShadowType LeftShadow[VectorSize], RightShadow[VectorSize];
+  CopyAndAlign<VectorSize>(LeftShadow, LeftShadowOperand);
+  CopyAndAlign<VectorSize>(RightShadow, RightShadowOperand);
+
+  auto ResShadow = reinterpret_cast<DoubleprecShadowFor<ShadowType> **>(Res);
+
+  for (int I = 0; I < VectorSize; I++)
+    ResShadow[I]->val = LeftShadow[I].val + RightShadow[I].val;
+  return LeftOperand + RightOperand;
+}
+
+template <typename MetaFloat>
+typename MetaFloat::FPType InsaneRuntime<MetaFloat>::Sub(
+    FPType LeftOperand, ShadowType **LeftShadowOperand, FPType RightOperand,
+    ShadowType **const RightShadowOperand, ShadowType **Res) {
+
+  if (BinaryKernel<simd::FSub, VectorSize>(LeftShadowOperand,
+                                            RightShadowOperand, Res))
+    return LeftOperand - RightOperand;
+
+  using DoublePrecShadowType = DoubleprecShadowFor<ShadowType>;
+  // We align both operands
+  DoublePrecShadowType LeftShadow[VectorSize], RightShadow[VectorSize];
+  CopyAndAlign<VectorSize>(LeftShadow, LeftShadowOperand);
+  CopyAndAlign<VectorSize>(RightShadow, RightShadowOperand);
+
+  auto ResShadow = reinterpret_cast<DoubleprecShadowFor<ShadowType> **>(Res);
+
+  for (int I = 0; I < VectorSize; I++)
+    ResShadow[I]->val = LeftShadow[I].val - RightShadow[I].val;
+
+  return LeftOperand - RightOperand;
+}
+
+template <typename MetaFloat>
+typename MetaFloat::FPType InsaneRuntime<MetaFloat>::Mul(
+    FPType LeftOperand, ShadowType **LeftShadowOperand, FPType RightOperand,
+    ShadowType **const RightShadowOperand, ShadowType **Res) {
+
+  if (BinaryKernel<simd::FMul, VectorSize>(LeftShadowOperand,
+                                            RightShadowOperand, Res))
+    return LeftOperand * RightOperand;
+
+  using DoublePrecShadowType = DoubleprecShadowFor<ShadowType>;
+  // We align both operands
+  DoublePrecShadowType LeftShadow[VectorSize], RightShadow[VectorSize];
+  CopyAndAlign<VectorSize>(LeftShadow, LeftShadowOperand);
+  CopyAndAlign<VectorSize>(RightShadow, RightShadowOperand);
+
+  auto ResShadow = reinterpret_cast<DoubleprecShadowFor<ShadowType> **>(Res);
+
+  for (int I = 0; I < VectorSize; I++)
+    ResShadow[I]->val = LeftShadow[I].val * RightShadow[I].val;
+
+  return LeftOperand * RightOperand;
+}
+
+template <typename MetaFloat>
+typename MetaFloat::FPType InsaneRuntime<MetaFloat>::Div(
+    FPType LeftOperand, ShadowType **LeftShadowOperand, FPType RightOperand,
+    ShadowType **const RightShadowOperand, ShadowType **Res) {
+
+  if (BinaryKernel<simd::FDiv, VectorSize>(LeftShadowOperand,
+                                            RightShadowOperand, Res))
+    return LeftOperand / RightOperand;
+
+  using DoublePrecShadowType = DoubleprecShadowFor<ShadowType>;
+  // We align both operands
+  DoublePrecShadowType LeftShadow[VectorSize], RightShadow[VectorSize];
+  CopyAndAlign<VectorSize>(LeftShadow, LeftShadowOperand);
+  CopyAndAlign<VectorSize>(RightShadow, RightShadowOperand);
+
+  auto ResShadow = reinterpret_cast<DoubleprecShadowFor<ShadowType> **>(Res);
+
+  for (int I = 0; I < VectorSize; I++)
+    ResShadow[I]->val = LeftShadow[I].val / RightShadow[I].val;
+
+  return LeftOperand / RightOperand;
+}
+
+template <typename MetaFloat>
+typename MetaFloat::FPType InsaneRuntime<MetaFloat>::Binary(
+    simd::BinaryOpcode Opcode, FPType LeftOperand,
+    ShadowSpan<ShadowType> LeftSpan, FPType RightOperand,
+    ShadowSpan<ShadowType> RightSpan, ShadowSpan<ShadowType> ResSpan) {
+
+  constexpr size_t Contiguous = sizeof(DoubleprecShadowFor<ShadowType>);
+  if constexpr (std::is_same_v<ShadowType, OpaqueShadow>) {
+    if (LeftSpan.Stride == Contiguous && RightSpan.Stride == Contiguous &&
+        ResSpan.Stride == Contiguous) {
+      auto *Left = reinterpret_cast<DoublePrecShadow *>(LeftSpan.Base);
+      auto *Right = reinterpret_cast<DoublePrecShadow *>(RightSpan.Base);
+      auto *Res = reinterpret_cast<DoublePrecShadow *>(ResSpan.Base);
+      switch (Opcode) {
+      case simd::FAdd:
+        simd::Dispatch<BlockKernel<simd::FAdd, VectorSize>>(Left, Right, Res);
+        break;
+      case simd::FSub:
+        simd::Dispatch<BlockKernel<simd::FSub, VectorSize>>(Left, Right, Res);
+        break;
+      case simd::FMul:
+        simd::Dispatch<BlockKernel<simd::FMul, VectorSize>>(Left, Right, Res);
+        break;
+      case simd::FDiv:
+        simd::Dispatch<BlockKernel<simd::FDiv, VectorSize>>(Left, Right, Res);
+        break;
+      }
+      return simd::Apply(Opcode, LeftOperand, RightOperand);
+    }
+  }
+
+  // Non-contiguous, and large, shadows go through the pointer arrays
+  ShadowType *LeftShadow[VectorSize] = {}, *RightShadow[VectorSize] = {},
+             *ResShadow[VectorSize] = {};
+  LeftSpan.template gather<VectorSize>(LeftShadow);
+  RightSpan.template gather<VectorSize>(RightShadow);
+  ResSpan.template gather<VectorSize>(ResShadow);
+  switch (Opcode) {
+  case simd::FAdd:
+    return Add(LeftOperand, LeftShadow, RightOperand, RightShadow, ResShadow);
+  case simd::FSub:
+    return Sub(LeftOperand, LeftShadow, RightOperand, RightShadow, ResShadow);
+  case simd::FMul:
+    return Mul(LeftOperand, LeftShadow, RightOperand, RightShadow, ResShadow);
+  default:
+    return Div(LeftOperand, LeftShadow, RightOperand, RightShadow, ResShadow);
+  }
+}
+
+template <typename MetaFloat>
+typename MetaFloat::FPType InsaneRuntime<MetaFloat>::Fma(
+    FPType LeftOperand, ShadowType **LeftShadowOperand, FPType RightOperand,
+    ShadowType **RightShadowOperand, FPType AddendOperand,
+    ShadowType **AddendShadowOperand, ShadowType **Res) {
+
+  using DoublePrecShadowType = DoubleprecShadowFor<ShadowType>;
+  // We align every operand
+  DoublePrecShadowType LeftShadow[VectorSize], RightShadow[VectorSize],
+      AddendShadow[VectorSize];
+  CopyAndAlign<VectorSize>(LeftShadow, LeftShadowOperand);
+  CopyAndAlign<VectorSize>(RightShadow, RightShadowOperand);
+  CopyAndAlign<VectorSize>(AddendShadow, AddendShadowOperand);
+
+  auto ResShadow = reinterpret_cast<DoubleprecShadowFor<ShadowType> **>(Res);
+
+  for (int I = 0; I < VectorSize; I++)
+    ResShadow[I]->val = FusedMultiplyAdd(LeftShadow[I].val, RightShadow[I].val,
+                                         AddendShadow[I].val);
+
+  return utils::fma(LeftOperand, RightOperand, AddendOperand);
+}
+
+template <typename MetaFloat>
+typename MetaFloat::FPType
+InsaneRuntime<MetaFloat>::Math(MathOpcode Opcode, FPType Operand,
+                               ShadowType **ShadowOperand, ShadowType **Res) {
+
+  using DoublePrecShadowType = DoubleprecShadowFor<ShadowType>;
+  // We align the operand
+  DoublePrecShadowType Shadow[VectorSize];
+  CopyAndAlign<VectorSize>(Shadow, ShadowOperand);
+
+  auto ResShadow = reinterpret_cast<DoubleprecShadowFor<ShadowType> **>(Res);
+
+  for (int I = 0; I < VectorSize; I++)
+    ResShadow[I]->val = ShadowMath(Opcode, Shadow[I].val, Shadow[I].val);
+
+  return ApplyMath(Opcode, Operand);
+}
+
+template <typename MetaFloat>
+typename MetaFloat::FPType InsaneRuntime<MetaFloat>::Pow(
+    FPType LeftOperand, ShadowType **LeftShadowOperand, FPType RightOperand,
+    ShadowType **RightShadowOperand, ShadowType **Res) {
+
+  using DoublePrecShadowType = DoubleprecShadowFor<ShadowType>;
+  // We align both operands
+  DoublePrecShadowType LeftShadow[VectorSize], RightShadow[VectorSize];
+  CopyAndAlign<VectorSize>(LeftShadow, LeftShadowOperand);
+  CopyAndAlign<VectorSize>(RightShadow, RightShadowOperand);
+
+  auto ResShadow = reinterpret_cast<DoubleprecShadowFor<ShadowType> **>(Res);
+
+  for (int I = 0; I < VectorSize; I++)
+    ResShadow[I]->val =
+        ShadowMath(Math_pow, LeftShadow[I].val, RightShadow[I].val);
+
+  return ApplyMath(Math_pow, LeftOperand, RightOperand);
+}
+
+template <typename MetaFloat>
+typename MetaFloat::ScalarType InsaneRuntime<MetaFloat>::Reduce(
+    ReduceOpcode Opcode, bool Reassoc, ScalarType Start,
+    ShadowType **StartShadowOperand, FPType Operand,
+    ShadowType **ShadowOperand, ShadowType **Res) {
+
+  using DoublePrecShadowType = DoubleprecShadowFor<ShadowType>;
+  // We align both operands
+  DoublePrecShadowType StartShadow[1], Shadow[VectorSize];
+  CopyAndAlign<1>(StartShadow, StartShadowOperand);
+  CopyAndAlign<VectorSize>(Shadow, ShadowOperand);
+
+  auto ResShadow = reinterpret_cast<DoubleprecShadowFor<ShadowType> **>(Res);
+
+  // In the native order, sequential unless Reassoc, see ApplyReduce
+  if (not Reassoc) {
+    for (size_t I = 0; I < VectorSize; I++)
+      StartShadow[0].val =
+          ApplyReduceStep(Opcode, StartShadow[0].val, Shadow[I].val);
+    ResShadow[0]->val = StartShadow[0].val;
+  } else {
+    for (size_t Width = VectorSize / 2; Width > 0; Width /= 2)
+      for (size_t I = 0; I < Width; I++)
+        Shadow[I].val =
+            ApplyReduceStep(Opcode, Shadow[I].val, Shadow[I + Width].val);
+    ResShadow[0]->val =
+        ApplyReduceStep(Opcode, StartShadow[0].val, Shadow[0].val);
+  }
+
+  return ApplyReduce(Opcode, Reassoc, Start, Operand);
+}
+
+// Called when we need to compare the native value with the shadow one to
+// see if they have diverged
+template <typename MetaFloat>
+template <unsigned Policy>
+bool InsaneRuntime<MetaFloat>::Check(FPType Operand,
+                                     ShadowType **ShadowOperand) {
+  // Skipped outside of the regions of interest
+  if (not CheckingEnabled())
+    return false;
+
+  // We align both operands
+  DoubleprecShadowFor<ShadowType> Shadow[VectorSize];
+  CopyAndAlign<VectorSize>(Shadow, ShadowOperand);
+
+  bool Res = false;
+  // We unvectorize the check
+  // We shall not acess Operand[I] if we're not working on vectors
+  if constexpr (VectorSize > 1 &&
+                std::is_same_v<ShadowType, OpaqueShadow>) {
+    ScalarType Lanes[VectorSize];
+    std::memcpy(Lanes, &Operand, sizeof(Lanes));
+    Res = simd::Dispatch<CheckLanesKernel<VectorSize>>(Lanes, Shadow);
+    CountRegionCheck(Res);
+    return Res;
+  } else if constexpr (VectorSize > 1) {
+    // Loop until failure or all elements have been checked
+    for (int I = 0; not Res && (I < VectorSize); I++)
+      Res = Res || CheckInternal(Operand[I], &Shadow[I]);
+    CountRegionCheck(Res);
+    return Res;
+  } else
+    Res = CheckInternal(Operand, &Shadow[0]);
+
+  CountRegionCheck(Res);
+  if (Res) {
+    // We may want to store additional information
+    if (Reports<Policy>(Report_StackRecording))
+      InsaneContext::getInstance().getWarningRecorder().Record();
+    if (Reports<Policy>(Report_Warnings))
+      CheckFail<VectorSize>(Operand, Shadow);
+
+    if (Reports<Policy>(Report_ExitOnError))
+      exit(1);
+  }
+  return Res;
+}
+
+// We need to perform the comparison with both shadows, and compare it to
+// the native result To ease the implementaiton, we take the native result
+// as a parameter
+template <typename MetaFloat>
+template <FCmpOpcode Opcode, unsigned Policy>
+bool InsaneRuntime<MetaFloat>::CheckFCmp(FPType LeftOperand,
+                                         ShadowType **LeftShadowOperand,
+                                         FPType RightOperand,
+                                         ShadowType **RightShadowOperand,
+                                         bool Value) {
+  // Skipped outside of the regions of interest, the native result is kept
+  if (not CheckingEnabled())
+    return Value;
+
+  using DoublePrecShadowType = DoubleprecShadowFor<ShadowType>;
+  // We align both operands
+  DoublePrecShadowType LeftShadow[VectorSize], RightShadow[VectorSize];
+  CopyAndAlign<VectorSize>(LeftShadow, LeftShadowOperand);
+  CopyAndAlign<VectorSize>(RightShadow, RightShadowOperand);
+
+  // We perfom the same comparisons in the shadow space
+  bool Res = FCmp<Opcode, VectorSize>(LeftShadow, RightShadow);
+  CountRegionCheck(Value != Res);
+
+  // We expect both comparison to be equal, else we emit a warning
+  if (Value != Res) {
+    // We may want to store additional informations
+    if (Reports<Policy>(Report_StackRecording))
+      InsaneContext::getInstance().getWarningRecorder().Record();
+    if (Reports<Policy>(Report_Warnings))
+      FCmpCheckFail<VectorSize>(LeftOperand, LeftShadow, RightOperand,
+                                RightShadow);
+
+    if (Reports<Policy>(Report_ExitOnError))
+      exit(1);
+  }
+  // We return the shadow comparison result to be able to correctly branch
+  return Res;
+}
+
+// We simply extend the original shadow to double precision
+template <typename MetaFloat>
+void InsaneRuntime<MetaFloat>::MakeShadowRange(ScalarType const *Operand,
+                                               ShadowType *Res, size_t Count) {
+  using DoublePrecShadowType = DoubleprecShadowFor<ShadowType>;
+  simd::FillRange(Operand, reinterpret_cast<DoublePrecShadowType *>(Res), Count,
+                  FillShadows<ScalarType, DoublePrecShadowType>);
+}
+
+template <typename MetaFloat>
+void InsaneRuntime<MetaFloat>::CopyShadowRange(ShadowType *Res,
+                                               ShadowType const *Operand,
+                                               size_t Count) {
+  // glibc switches to non-temporal stores for large copies by itself
+  std::memmove(Res, Operand, Count * sizeof(DoubleprecShadowFor<ShadowType>));
+}
+
+template <typename MetaFloat>
+void InsaneRuntime<MetaFloat>::MakeShadow(FPType Operand, ShadowType **Res) {
+  auto ResShadow = reinterpret_cast<DoubleprecShadowFor<ShadowType> **>(Res);
+
+  for (int I = 0; I < VectorSize; I++) {
+    // We shall only use Operand[I] when working on vectors
+    if constexpr (VectorSize > 1)
+      ResShadow[I]->val = Operand[I];
+    else
+      ResShadow[0]->val = Operand;
+  }
+}
+
+template <typename MetaFloat>
+void InsaneRuntime<MetaFloat>::CastToFloat(FPType Operand,
+                                           ShadowType **ShadowOperand,
+                                           OpaqueShadow **Res) {
+  // We align the shadow
+  using DoublePrecShadowType = DoubleprecShadowFor<ShadowType>;
+  DoublePrecShadowType Shadow[VectorSize];
+  CopyAndAlign<VectorSize>(Shadow, ShadowOperand);
+
+  auto ResShadow = reinterpret_cast<DoublePrecShadow **>(Res);
+
+  CastInternal<VectorSize>(Operand, Shadow, ResShadow);
+}
+
+template <typename MetaFloat>
+void InsaneRuntime<MetaFloat>::CastToDouble(FPType Operand,
+                                            ShadowType **ShadowOperand,
+                                            OpaqueLargeShadow **Res) {
+  // We align the shadow
+  using DoublePrecShadowType = DoubleprecShadowFor<ShadowType>;
+  DoublePrecShadowType Shadow[VectorSize];
+  CopyAndAlign<VectorSize>(Shadow, ShadowOperand);
+
+  auto ResShadow = reinterpret_cast<DoublePrecLargeShadow **>(Res);
+
+  CastInternal<VectorSize>(Operand, Shadow, ResShadow);
+}
+
+template <typename MetaFloat>
+void InsaneRuntime<MetaFloat>::CastToLongdouble(FPType Operand,
+                                                ShadowType **ShadowOperand,
+                                                OpaqueLargeShadow **Res) {
+  // We align the shadow
+  using DoublePrecShadowType = DoubleprecShadowFor<ShadowType>;
+  DoublePrecShadowType Shadow[VectorSize];
+  CopyAndAlign<VectorSize>(Shadow, ShadowOperand);
+
+  auto ResShadow = reinterpret_cast<DoublePrecLargeShadow **>(Res);
+
+  CastInternal<VectorSize>(Operand, Shadow, ResShadow);
+}
+
+} // namespace insane
@@ -11,6 +11,7 @@
 
 #pragma once
 #include "Backend.hpp"
+#include "DoubleDouble.hpp"
 #include "Flags.hpp"
 #include "OpaqueShadow.hpp"
 #include "Utils.hpp"
@@ -68,4 +69,25 @@ static_assert(sizeof(MCASyncLargeShadow) == 32, "Invalid Large shadow size");
 // https://github.com/milankl/StochasticRounding.jl/blob/main/src/float32sr.jl
 float StochasticRound(double x);
 double StochasticRound(__float128 x);
+
+// Rounds the unevaluated sum hi + lo, much faster than the __float128 version
+double StochasticRound(DoubleDouble x);
+
+// Rounds the exact sum Value + Error, with Value = fl(Value + Error), without
+// widening to double. Error comes from error-free transformations
+float StochasticRound(float Value, float Error);
+
+// Rounds the three samples of a widened MCASyncShadow at once
+// The last lane matches the shadow padding, it is ignored and set to 0
+v4float StochasticRound(v4double x);
+
+// Number of roundings whose result was exactly representable, for which the
+// random perturbation was skipped, among all roundings
+struct RoundingStats {
+  uint64_t Exact;
+  uint64_t Total;
+};
+
+// Counts of the exited and running threads
+RoundingStats GetRoundingStats();
 } // namespace insane::mcasync
\ No newline at end of file
@@ -0,0 +1,1079 @@
+/**
+ * @file MCASyncImpl.hpp
+ * @author Mathys JAM (mathys.jam@ens.uvsq.fr), Pablo Oliveira
+ * (pablo.oliveira@ens.uvsq.fr) and Eric Petit (eric.petit@ens.uvsq.fr)
+ * @brief Template definitions of the MCA Synchrone backend
+ *
+ * Included by MCASync.cpp, and by the generated interface in inline builds so
+ * that the backend can be inlined into the instrumented code with LTO
+ * @version 0.7.1
+ *
+ *
+ */
+
+#pragma once
+#include "Context.hpp"
+#include "Region.hpp"
+#include "Simd.hpp"
+#include "WarningLog.hpp"
+#include "backends/MCASync.hpp"
+#include <atomic>
+#include <cstring>
+
+namespace insane {
+
+/* ========================================================================= */
+/* MCASync backend specific functions and structures                         */
+/*                                                                           */
+/*                                                                           */
+/*                                                                           */
+/* ========================================================================= */
+namespace mcasync {
+
+// Counts are kept per thread, constant-initialized so that counting needs no
+// TLS guard. Threads register on their first count, see MCASync.cpp
+struct LocalRoundingStats {
+  std::atomic<uint64_t> Exact{0};
+  std::atomic<uint64_t> Total{0};
+  bool Registered = false;
+};
+
+inline thread_local LocalRoundingStats ThreadRoundingStats;
+
+void RegisterRoundingThread();
+
+inline void CountRoundings(uint64_t Exact, uint64_t Total) {
+  if (__builtin_expect(not ThreadRoundingStats.Registered, 0))
+    RegisterRoundingThread();
+  AddToCounter(ThreadRoundingStats.Exact, Exact);
+  AddToCounter(ThreadRoundingStats.Total, Total);
+  CountRegionRoundings(Exact, Total);
+}
+
+// Relative variance threshold of CheckInternal, 10^(-2 * required digits)
+// Set from the flags at initialization
+inline double VarianceThreshold = 1e-14;
+
+// Lane-parallel StochasticRound(double), subnormals and exact lanes are blended
+// to avoid branching on each lane
+// Only the first Used lanes of every Period are counted in the rounding stats
+// Must be inlined to be compiled for the caller's instruction set
+template <size_t Size>
+__attribute__((always_inline)) inline simd::Vector_t<float, Size>
+StochasticRoundLanes(simd::Vector_t<double, Size> x, size_t Used = Size,
+                     size_t Period = Size) {
+  using ExtendedVector = simd::Vector_t<double, Size>;
+  using IntVector = simd::Vector_t<int64_t, Size>;
+  using FloatVector = simd::Vector_t<float, Size>;
+  // Rounded to nearest while checking is off, see Region.hpp
+  if (not CheckingEnabled())
+    return __builtin_convertvector(x, FloatVector);
+  // Smallest float subnormal
+  constexpr double EpsF32 = 0x1p-149;
+  constexpr int64_t OneF64 = 0x3FF0000000000000;
+
+  // Lanes that survive the round trip to float need no random bits
+  FloatVector Narrow = __builtin_convertvector(x, FloatVector);
+  IntVector Exact = __builtin_convertvector(Narrow, ExtendedVector) == x;
+  size_t ExactCount = 0;
+  for (size_t I = 0; I < Size; I++)
+    ExactCount += I % Period < Used && Exact[I] != 0;
+  CountRoundings(ExactCount, Size / Period * Used);
+  if (simd::All(Exact))
+    return Narrow;
+
+  // Two roundings are served by each random word
+  IntVector RandomBits;
+  for (size_t I = 0; I < Size; I++)
+    RandomBits[I] = Exact[I] ? 0 : utils::randbits<29>();
+
+  ExtendedVector Abs = x < 0 ? -x : x;
+  // Vector casts reinterpret the bits, __builtin_convertvector converts values
+  ExtendedVector Res = (ExtendedVector)((IntVector)x + (RandomBits | 1));
+
+  // subnormals are rounded with float-arithmetic, they are rare enough to
+  // draw their random bits separately. Zeros are exact and skip them
+  IntVector IsSubnormal = (Abs < std::numeric_limits<float>::min()) & ~Exact;
+  if (simd::Any(IsSubnormal)) {
+    IntVector Mantissa;
+    for (size_t I = 0; I < Size; I++)
+      Mantissa[I] = utils::rand<uint64_t>() >> 12;
+    ExtendedVector Uniform = (ExtendedVector)(Mantissa | OneF64) - 1.5;
+    Res = IsSubnormal ? x + EpsF32 * Uniform : Res;
+  }
+
+  // Exact lanes, infinites included, are blended back
+  Res = Exact ? x : Res;
+  return __builtin_convertvector(Res, FloatVector);
+}
+
+// Lane-parallel StochasticRound(float, float), and StochasticRound(DoubleDouble)
+// for doubles
+// Must be inlined to be compiled for the caller's instruction set
+template <size_t Size, typename T = float>
+__attribute__((always_inline)) inline simd::Vector_t<T, Size>
+StochasticRoundLanes(simd::Vector_t<T, Size> Value,
+                     simd::Vector_t<T, Size> Error, size_t Used = Size,
+                     size_t Period = Size) {
+  using FPVector = simd::Vector_t<T, Size>;
+  using IntType = std::conditional_t<sizeof(T) == 4, int32_t, int64_t>;
+  using IntVector = simd::Vector_t<IntType, Size>;
+  constexpr int Digits = std::numeric_limits<T>::digits;
+  if (not CheckingEnabled())
+    return Value;
+
+  // Exact lanes need no random bits. Infinites and NaNs, whose errors are
+  // NaNs, are returned as is
+  IntVector Exact = (Error == 0) | (Value - Value != 0);
+  size_t ExactCount = 0;
+  for (size_t I = 0; I < Size; I++)
+    ExactCount += I % Period < Used && Exact[I] != 0;
+  CountRoundings(ExactCount, Size / Period * Used);
+  if (simd::All(Exact))
+    return Value;
+
+  // Moving away from zero increments the bits, moving towards zero decrements
+  // them. Zeros move to the smallest subnormal of the sign of Error
+  IntVector Away = (Value < 0) == (Error < 0);
+  IntVector Neighbour = (IntVector)Value + ((Away & 2) - 1);
+  IntVector Smallest =
+      (IntVector)(Error < 0) & std::numeric_limits<IntType>::min();
+  Neighbour = Value == 0 ? Smallest | 1 : Neighbour;
+  FPVector Ulp = (FPVector)Neighbour - Value;
+  Ulp = Ulp < 0 ? -Ulp : Ulp;
+
+  // Uniform in [0, 1), the product with a power of two is exact
+  IntVector RandomBits = {};
+  for (size_t I = 0; I < Size; I++) {
+    if (Exact[I])
+      continue;
+    if constexpr (sizeof(T) == 4)
+      RandomBits[I] = utils::randbits<Digits>() & 0xFFFFFF;
+    else
+      RandomBits[I] = utils::rand<uint64_t>() >> 11;
+  }
+  FPVector Uniform =
+      __builtin_convertvector(RandomBits, FPVector) * T(1. / (1ull << Digits));
+
+  // NaN errors always fail the comparison
+  FPVector AbsError = Error < 0 ? -Error : Error;
+  return AbsError > Uniform * Ulp ? (FPVector)Neighbour : Value;
+}
+
+// Shadow struct and helper methods
+template <size_t VectorSize, typename MCASyncShadow, typename DestType>
+void CastInternal(MCASyncShadow **Shadow, DestType Res) {
+  // We just copy every value
+  for (int I = 0; I < VectorSize; I++) {
+    Res[I]->val[0] = Shadow[I]->val[0];
+    Res[I]->val[1] = Shadow[I]->val[1];
+    Res[I]->val[2] = Shadow[I]->val[2];
+  }
+}
+
+// Checks the shadow has less than the required significant digits
+// -log10(sqrt(Variance) / |Mean|) <= Digits is rewritten as
+// Variance >= Mean^2 * 10^(-2 * Digits), to avoid any libm call
+template <typename MCASyncShadow> bool CheckInternal(MCASyncShadow *Shadow) {
+
+  double Mean = Shadow->mean();
+
+  double Variance = 0;
+  for (int I = 0; I < 3; I++) {
+    double Deviation = Shadow->val[I] - Mean;
+    Variance += Deviation * Deviation;
+  }
+  Variance /= 3.0;
+
+  // Identical samples have infinitely many significant digits, even when the
+  // mean is 0. NaNs fail both comparisons
+  return Variance > 0 && Variance >= Mean * Mean * VarianceThreshold;
+}
+
+// CheckInternal on every lane of a vector at once, true if any lane fails
+template <size_t VectorSize, typename MCASyncShadow> struct CheckLanesKernel {
+  static __attribute__((always_inline)) bool Run(MCASyncShadow **Shadow) {
+    using ValueT = std::remove_reference_t<decltype(Shadow[0]->val[0])>;
+    using ValueVector = simd::Vector_t<ValueT, VectorSize>;
+    using ExtendedVector = simd::Vector_t<double, VectorSize>;
+
+    ValueVector Samples[3];
+    for (int Sample = 0; Sample < 3; Sample++)
+      for (size_t I = 0; I < VectorSize; I++)
+        Samples[Sample][I] = Shadow[I]->val[Sample];
+
+    // Rounded to float like mean()
+    ExtendedVector Mean = __builtin_convertvector(
+        __builtin_convertvector((Samples[0] + Samples[1] + Samples[2]) / 3,
+                                simd::Vector_t<float, VectorSize>),
+        ExtendedVector);
+
+    ExtendedVector Variance = {};
+    for (int Sample = 0; Sample < 3; Sample++) {
+      ExtendedVector Deviation =
+          __builtin_convertvector(Samples[Sample], ExtendedVector) - Mean;
+      Variance += Deviation * Deviation;
+    }
+    Variance /= 3.0;
+
+    return simd::Any((Variance > 0) &
+                     (Variance >= Mean * Mean * VarianceThreshold));
+  }
+};
+
+// Formats the payload of a failed check, on the warning writer thread
+template <size_t VectorSize, typename FPType, typename MCASyncShadow>
+void FormatCheckFail(WarningPayloadReader &Payload, std::ostream &Out) {
+  auto Operand = Payload.get<FPType>();
+  auto Shadow = Payload.get<MCASyncShadow>();
+
+  Out << utils::AsciiColor::Red.str();
+  Out << "[MCASync] Low precision shadow result :" << std::setprecision(20)
+      << "\n";
+
+  Out << "\tNative Value: ";
+  // We shall not acess Operand[I] if we're not working on vectors
+  if constexpr (VectorSize > 1)
+    for (int I = 0; I < VectorSize; I++)
+      Out << Operand[I] << "\n";
+  else
+    Out << Operand << "\n";
+
+  Out << "\tShadow Value: \n\t  " << Shadow << "\n";
+}
+
+// Formats the payload of a failed comparison check
+template <size_t VectorSize, typename FPType, typename MCASyncShadow>
+void FormatFCmpCheckFail(WarningPayloadReader &Payload, std::ostream &Out) {
+  auto LeftOperand = Payload.get<FPType>();
+  auto RightOperand = Payload.get<FPType>();
+
+  Out << utils::AsciiColor::Red.str();
+  Out << "[MCASync] Floating-point comparison results depend on precision\n";
+  Out << "\tValue  a: { ";
+  if constexpr (VectorSize > 1) {
+    for (int I = 0; I < VectorSize; I++)
+      Out << LeftOperand[I] << " ";
+    Out << "} b: ";
+    for (int I = 0; I < VectorSize; I++)
+      Out << RightOperand[I] << " ";
+  } else
+    Out << LeftOperand << " } b: {" << RightOperand;
+  Out << "Shadow a:\n";
+  for (int I = 0; I < VectorSize; I++)
+    Out << "\t" << Payload.get<MCASyncShadow>() << "\n";
+  Out << "Shadow b:\n";
+  for (int I = 0; I < VectorSize; I++)
+    Out << "\t" << Payload.get<MCASyncShadow>() << "\n";
+}
+
+// Compares the means of the shadows on every lane at once, true if Opcode
+// holds on every lane
+template <FCmpOpcode Opcode, size_t VectorSize, typename MCASyncShadow>
+struct FCmpKernel {
+  static __attribute__((always_inline)) bool Run(MCASyncShadow **LeftShadow,
+                                                 MCASyncShadow **RightShadow) {
+    using ExtendedVector = simd::Vector_t<double, VectorSize>;
+
+    ExtendedVector Left, Right;
+    for (size_t I = 0; I < VectorSize; I++) {
+      Left[I] = LeftShadow[I]->mean();
+      Right[I] = RightShadow[I]->mean();
+    }
+    return ReduceFCmp<Opcode>(Left, Right);
+  }
+};
+
+template <FCmpOpcode Opcode, size_t VectorSize, typename MCASyncShadow>
+bool FCmpInternal(MCASyncShadow **LeftShadow, MCASyncShadow **RightShadow) {
+  if constexpr (VectorSize == 1)
+    return ApplyFCmp<Opcode>(double(LeftShadow[0]->mean()),
+                             double(RightShadow[0]->mean()));
+  else
+    return simd::Dispatch<FCmpKernel<Opcode, VectorSize, MCASyncShadow>>(
+        LeftShadow, RightShadow);
+}
+
+// Value + Error == a Opcode b, exactly except for divisions where Error is
+// rounded. Works on both scalars and vectors
+template <simd::BinaryOpcode Opcode, typename T>
+__attribute__((always_inline)) inline void ExactApply(T a, T b, T &Value,
+                                                      T &Error) {
+  if constexpr (Opcode == simd::FAdd)
+    eft::TwoSum(a, b, Value, Error);
+  else if constexpr (Opcode == simd::FSub)
+    eft::TwoSum(a, -b, Value, Error);
+  else if constexpr (Opcode == simd::FMul)
+    eft::TwoProd(a, b, Value, Error);
+  else {
+    Value = a / b;
+    T Prod, ProdError;
+    eft::TwoProd(Value, b, Prod, ProdError);
+    Error = ((a - Prod) - ProdError) / b;
+  }
+}
+
+// Computes Left Opcode Right on every lane, stochastically rounded to float
+// Either with error-free transformations in float, or in double precision
+template <simd::BinaryOpcode Opcode, size_t Size>
+__attribute__((always_inline)) inline simd::Vector_t<float, Size>
+RoundedApply(simd::Vector_t<float, Size> Left,
+             simd::Vector_t<float, Size> Right, size_t Used = Size,
+             size_t Period = Size) {
+#ifdef INSANE_MCASYNC_EFT_ROUNDING
+  simd::Vector_t<float, Size> Value, Error;
+  ExactApply<Opcode>(Left, Right, Value, Error);
+  return StochasticRoundLanes<Size>(Value, Error, Used, Period);
+#else
+  using ExtendedVector = simd::Vector_t<double, Size>;
+  return StochasticRoundLanes<Size>(
+      simd::Apply<Opcode>(__builtin_convertvector(Left, ExtendedVector),
+                          __builtin_convertvector(Right, ExtendedVector)),
+      Used, Period);
+#endif
+}
+
+// Performs Opcode on every sample of a scalar float shadow at once, instead of
+// rounding each sample separately. The padding is loaded along the samples
+template <simd::BinaryOpcode Opcode> struct SamplesKernel {
+  static __attribute__((always_inline)) void
+  Run(MCASyncShadow const *LeftShadow, MCASyncShadow const *RightShadow,
+      MCASyncShadow *Res) {
+    v4float Left, Right;
+    std::memcpy(&Left, LeftShadow, sizeof(MCASyncShadow));
+    std::memcpy(&Right, RightShadow, sizeof(MCASyncShadow));
+
+    v4float Rounded = RoundedApply<Opcode, 4>(Left, Right, 3);
+    Rounded[3] = 0;
+    std::memcpy(Res, &Rounded, sizeof(MCASyncShadow));
+  }
+};
+
+// Performs Opcode on every lane of a float vector at once, one sample at a time
+template <simd::BinaryOpcode Opcode, size_t VectorSize> struct LanesKernel {
+  static __attribute__((always_inline)) void Run(MCASyncShadow **LeftShadow,
+                                                 MCASyncShadow **RightShadow,
+                                                 MCASyncShadow **Res) {
+    using FloatVector = simd::Vector_t<float, VectorSize>;
+
+    for (int Sample = 0; Sample < 3; Sample++) {
+      FloatVector Left, Right;
+      for (size_t I = 0; I < VectorSize; I++) {
+        Left[I] = LeftShadow[I]->val[Sample];
+        Right[I] = RightShadow[I]->val[Sample];
+      }
+
+      FloatVector Rounded = RoundedApply<Opcode, VectorSize>(Left, Right);
+      for (size_t I = 0; I < VectorSize; I++)
+        Res[I]->val[Sample] = Rounded[I];
+    }
+  }
+};
+
+// Performs Opcode on the contiguous shadows of a float vector, as a single
+// vector of samples and paddings. The paddings are not counted in the rounding
+// stats, and cleared
+template <simd::BinaryOpcode Opcode, size_t VectorSize> struct BlockKernel {
+  static __attribute__((always_inline)) void
+  Run(MCASyncShadow const *LeftShadow, MCASyncShadow const *RightShadow,
+      MCASyncShadow *Res) {
+    using BlockVector = simd::Vector_t<float, 4 * VectorSize>;
+    static_assert(sizeof(BlockVector) == VectorSize * sizeof(MCASyncShadow));
+
+    // Shadows are only aligned on floats
+    BlockVector Left, Right;
+    std::memcpy(&Left, LeftShadow, sizeof(BlockVector));
+    std::memcpy(&Right, RightShadow, sizeof(BlockVector));
+
+    BlockVector Rounded =
+        RoundedApply<Opcode, 4 * VectorSize>(Left, Right, 3, 4);
+    for (size_t I = 3; I < 4 * VectorSize; I += 4)
+      Rounded[I] = 0;
+    std::memcpy(Res, &Rounded, sizeof(BlockVector));
+  }
+};
+
+// Float shadows are computed with vectors, either across samples for scalars
+// or across lanes for vectors
+template <simd::BinaryOpcode Opcode, size_t VectorSize>
+void BinaryKernel(MCASyncShadow **LeftShadow, MCASyncShadow **RightShadow,
+                  MCASyncShadow **Res) {
+  if constexpr (VectorSize == 1)
+    simd::Dispatch<SamplesKernel<Opcode>>(LeftShadow[0], RightShadow[0],
+                                          Res[0]);
+  else
+    simd::Dispatch<LanesKernel<Opcode, VectorSize>>(LeftShadow, RightShadow,
+                                                    Res);
+}
+
+// Double shadows of every lane are loaded whole in a single vector of samples
+// and paddings, see LargeBinaryKernel
+template <size_t VectorSize>
+__attribute__((always_inline)) inline simd::Vector_t<double, 4 * VectorSize>
+LoadLargeShadows(MCASyncLargeShadow **Shadow) {
+  using BlockVector = simd::Vector_t<double, 4 * VectorSize>;
+  static_assert(sizeof(BlockVector) ==
+                VectorSize * sizeof(MCASyncLargeShadow));
+
+  BlockVector Res;
+  for (size_t I = 0; I < VectorSize; I++)
+    std::memcpy(reinterpret_cast<char *>(&Res) + I * sizeof(*Shadow[I]),
+                Shadow[I], sizeof(*Shadow[I]));
+  return Res;
+}
+
+// Clears the paddings, and stores the samples of every lane
+template <size_t VectorSize>
+__attribute__((always_inline)) inline void
+StoreLargeShadows(simd::Vector_t<double, 4 * VectorSize> Value,
+                  MCASyncLargeShadow **Res) {
+  for (size_t I = 3; I < 4 * VectorSize; I += 4)
+    Value[I] = 0;
+  for (size_t I = 0; I < VectorSize; I++)
+    std::memcpy(Res[I], reinterpret_cast<char *>(&Value) + I * sizeof(*Res[I]),
+                sizeof(*Res[I]));
+}
+
+// Double shadows are computed with error-free transformations in double
+// rather than __float128, which is software emulated. Every sample of every
+// lane is computed at once, the paddings are not counted in the rounding stats
+template <simd::BinaryOpcode Opcode, size_t VectorSize>
+struct LargeBinaryKernel {
+  static __attribute__((always_inline)) void
+  Run(MCASyncLargeShadow **LeftShadow, MCASyncLargeShadow **RightShadow,
+      MCASyncLargeShadow **Res) {
+    using BlockVector = simd::Vector_t<double, 4 * VectorSize>;
+
+    BlockVector Value, Error;
+    ExactApply<Opcode>(LoadLargeShadows<VectorSize>(LeftShadow),
+                       LoadLargeShadows<VectorSize>(RightShadow), Value,
+                       Error);
+    StoreLargeShadows<VectorSize>(
+        StochasticRoundLanes<4 * VectorSize, double>(Value, Error, 3, 4), Res);
+  }
+};
+
+template <simd::BinaryOpcode Opcode, size_t VectorSize>
+void BinaryKernel(MCASyncLargeShadow **LeftShadow,
+                  MCASyncLargeShadow **RightShadow, MCASyncLargeShadow **Res) {
+  simd::Dispatch<LargeBinaryKernel<Opcode, VectorSize>>(LeftShadow,
+                                                        RightShadow, Res);
+}
+
+// Computes Left * Right + Addend on every lane with a single stochastic
+// rounding to float. The product of two floats is exact in double, the sum is
+// carried with its error and rounded to odd: an inexact sum then never lands
+// on a float, and stays on the side of the exact one, which is all the
+// stochastic rounding needs from the bits below the double
+template <size_t Size>
+__attribute__((always_inline)) inline simd::Vector_t<float, Size>
+RoundedFma(simd::Vector_t<float, Size> Left, simd::Vector_t<float, Size> Right,
+           simd::Vector_t<float, Size> Addend, size_t Used = Size) {
+  using ExtendedVector = simd::Vector_t<double, Size>;
+  using IntVector = simd::Vector_t<int64_t, Size>;
+  ExtendedVector Sum, Error;
+  eft::TwoSum(__builtin_convertvector(Left, ExtendedVector) *
+                  __builtin_convertvector(Right, ExtendedVector),
+              __builtin_convertvector(Addend, ExtendedVector), Sum, Error);
+
+  // Truncated towards zero, one ulp down when Error has the other sign, and
+  // then made odd. NaN errors of infinite sums compare false and keep the sum
+  IntVector Inexact = (Error < 0) | (Error > 0);
+  IntVector Towards = (Error < 0) ^ (Sum < 0);
+  IntVector Bits = (IntVector)Sum;
+  Sum = (ExtendedVector)(Inexact ? (Bits + Towards) | 1 : Bits);
+  return StochasticRoundLanes<Size>(Sum, Used);
+}
+
+// Same as SamplesKernel, for a fused multiply-add
+struct FmaSamplesKernel {
+  static __attribute__((always_inline)) void
+  Run(MCASyncShadow const *LeftShadow, MCASyncShadow const *RightShadow,
+      MCASyncShadow const *AddendShadow, MCASyncShadow *Res) {
+    v4float Left, Right, Addend;
+    std::memcpy(&Left, LeftShadow, sizeof(MCASyncShadow));
+    std::memcpy(&Right, RightShadow, sizeof(MCASyncShadow));
+    std::memcpy(&Addend, AddendShadow, sizeof(MCASyncShadow));
+
+    v4float Rounded = RoundedFma<4>(Left, Right, Addend, 3);
+    Rounded[3] = 0;
+    std::memcpy(Res, &Rounded, sizeof(MCASyncShadow));
+  }
+};
+
+// Same as LanesKernel, for a fused multiply-add
+template <size_t VectorSize> struct FmaLanesKernel {
+  static __attribute__((always_inline)) void
+  Run(MCASyncShadow **LeftShadow, MCASyncShadow **RightShadow,
+      MCASyncShadow **AddendShadow, MCASyncShadow **Res) {
+    using FloatVector = simd::Vector_t<float, VectorSize>;
+
+    for (int Sample = 0; Sample < 3; Sample++) {
+      FloatVector Left, Right, Addend;
+      for (size_t I = 0; I < VectorSize; I++) {
+        Left[I] = LeftShadow[I]->val[Sample];
+        Right[I] = RightShadow[I]->val[Sample];
+        Addend[I] = AddendShadow[I]->val[Sample];
+      }
+
+      FloatVector Rounded = RoundedFma<VectorSize>(Left, Right, Addend);
+      for (size_t I = 0; I < VectorSize; I++)
+        Res[I]->val[Sample] = Rounded[I];
+    }
+  }
+};
+
+template <size_t VectorSize>
+void FmaKernel(MCASyncShadow **LeftShadow, MCASyncShadow **RightShadow,
+               MCASyncShadow **AddendShadow, MCASyncShadow **Res) {
+  if constexpr (VectorSize == 1)
+    simd::Dispatch<FmaSamplesKernel>(LeftShadow[0], RightShadow[0],
+                                     AddendShadow[0], Res[0]);
+  else
+    simd::Dispatch<FmaLanesKernel<VectorSize>>(LeftShadow, RightShadow,
+                                               AddendShadow, Res);
+}
+
+// The exact product is kept with its error, and rounded once after the
+// addition, as the double-double Product + Addend
+template <size_t VectorSize> struct LargeFmaKernel {
+  static __attribute__((always_inline)) void
+  Run(MCASyncLargeShadow **LeftShadow, MCASyncLargeShadow **RightShadow,
+      MCASyncLargeShadow **AddendShadow, MCASyncLargeShadow **Res) {
+    using BlockVector = simd::Vector_t<double, 4 * VectorSize>;
+
+    BlockVector Product, ProductError, Sum, SumError, Value, Error;
+    eft::TwoProd(LoadLargeShadows<VectorSize>(LeftShadow),
+                 LoadLargeShadows<VectorSize>(RightShadow), Product,
+                 ProductError);
+    eft::TwoSum(Product, LoadLargeShadows<VectorSize>(AddendShadow), Sum,
+                SumError);
+    eft::FastTwoSum(Sum, SumError + ProductError, Value, Error);
+    // The errors of infinites are NaNs, which would spread to the sum
+    Value = Error == Error ? Value : Sum;
+    StoreLargeShadows<VectorSize>(
+        StochasticRoundLanes<4 * VectorSize, double>(Value, Error, 3, 4), Res);
+  }
+};
+
+template <size_t VectorSize>
+void FmaKernel(MCASyncLargeShadow **LeftShadow,
+               MCASyncLargeShadow **RightShadow,
+               MCASyncLargeShadow **AddendShadow, MCASyncLargeShadow **Res) {
+  simd::Dispatch<LargeFmaKernel<VectorSize>>(LeftShadow, RightShadow,
+                                             AddendShadow, Res);
+}
+
+// libm functions are evaluated in double precision with the vector libm, then
+// every sample is stochastically rounded at once. RightShadow is only read by
+// Math_pow
+inline void MathSamplesKernel(MathOpcode Opcode,
+                              MCASyncShadow const *LeftShadow,
+                              MCASyncShadow const *RightShadow,
+                              MCASyncShadow *Res) {
+  double Left[3], Right[3];
+  for (int Sample = 0; Sample < 3; Sample++) {
+    Left[Sample] = LeftShadow->val[Sample];
+    Right[Sample] = RightShadow->val[Sample];
+  }
+  // The padding lane stays 0, which is exact
+  v4double Extended = {0, 0, 0, 0};
+  ApplyMathArray(Opcode, Left, Right, reinterpret_cast<double *>(&Extended),
+                 3);
+
+  v4float Rounded = StochasticRoundLanes<4>(Extended, 3);
+  std::memcpy(Res, &Rounded, sizeof(MCASyncShadow));
+}
+
+// Same as MathSamplesKernel, the samples of every lane are evaluated in a
+// single call, and then rounded one sample of every lane at a time
+template <size_t VectorSize> struct MathLanesKernel {
+  static __attribute__((always_inline)) void
+  Run(MathOpcode Opcode, MCASyncShadow **LeftShadow,
+      MCASyncShadow **RightShadow, MCASyncShadow **Res) {
+    using ExtendedVector = simd::Vector_t<double, VectorSize>;
+    using FloatVector = simd::Vector_t<float, VectorSize>;
+
+    // Sample-major, so that each sample is a vector of lanes
+    ExtendedVector Left[3] = {}, Right[3] = {};
+    for (int Sample = 0; Sample < 3; Sample++)
+      for (size_t I = 0; I < VectorSize; I++) {
+        Left[Sample][I] = LeftShadow[I]->val[Sample];
+        Right[Sample][I] = RightShadow[I]->val[Sample];
+      }
+    ExtendedVector Extended[3] = {};
+    ApplyMathArray(Opcode, reinterpret_cast<double const *>(Left),
+                   reinterpret_cast<double const *>(Right),
+                   reinterpret_cast<double *>(Extended), 3 * VectorSize);
+
+    for (int Sample = 0; Sample < 3; Sample++) {
+      FloatVector Rounded = StochasticRoundLanes<VectorSize>(Extended[Sample]);
+      for (size_t I = 0; I < VectorSize; I++)
+        Res[I]->val[Sample] = Rounded[I];
+    }
+  }
+};
+
+template <size_t VectorSize>
+void MathKernel(MathOpcode Opcode, MCASyncShadow **LeftShadow,
+                MCASyncShadow **RightShadow, MCASyncShadow **Res) {
+  if constexpr (VectorSize == 1)
+    MathSamplesKernel(Opcode, LeftShadow[0], RightShadow[0], Res[0]);
+  else
+    simd::Dispatch<MathLanesKernel<VectorSize>>(Opcode, LeftShadow,
+                                                RightShadow, Res);
+}
+
+// Double samples need more precision than libmvec gives, they are evaluated
+// with the long double libm
+template <size_t VectorSize>
+void MathKernel(MathOpcode Opcode, MCASyncLargeShadow **LeftShadow,
+                MCASyncLargeShadow **RightShadow, MCASyncLargeShadow **Res) {
+  for (size_t I = 0; I < VectorSize; I++)
+    for (int Sample = 0; Sample < 3; Sample++) {
+      long double Extended = ApplyMath<long double>(
+          Opcode, LeftShadow[I]->val[Sample], RightShadow[I]->val[Sample]);
+      Res[I]->val[Sample] = StochasticRound(DoubleDouble(Extended));
+    }
+}
+
+// Combines Size pairs of shadows, one step of a tree reduction
+template <size_t Size, typename ShadowT>
+void ReduceStepKernel(ReduceOpcode Opcode, ShadowT **LeftShadow,
+                      ShadowT **RightShadow, ShadowT **Res) {
+  switch (Opcode) {
+  case Reduce_fadd:
+    return BinaryKernel<simd::FAdd, Size>(LeftShadow, RightShadow, Res);
+  case Reduce_fmul:
+    return BinaryKernel<simd::FMul, Size>(LeftShadow, RightShadow, Res);
+  default:
+    // Min and max are exact, every sample is selected separately
+    for (size_t I = 0; I < Size; I++)
+      for (int Sample = 0; Sample < 3; Sample++)
+        Res[I]->val[Sample] =
+            ApplyReduceStep(Opcode, LeftShadow[I]->val[Sample],
+                            RightShadow[I]->val[Sample]);
+  }
+}
+
+// Reduces Size shadows into Res by halves, as ApplyReduce with Reassoc, so
+// that each level is computed by a single kernel call
+template <size_t Size, typename ShadowT>
+void ReduceKernel(ReduceOpcode Opcode, ShadowT **Shadow, ShadowT **Res) {
+  constexpr size_t Half = Size / 2;
+  if constexpr (Half == 1)
+    ReduceStepKernel<1>(Opcode, Shadow, Shadow + 1, Res);
+  else {
+    ShadowT Partial[Half];
+    ShadowT *PartialPtr[Half];
+    for (size_t I = 0; I < Half; I++)
+      PartialPtr[I] = &Partial[I];
+
+    ReduceStepKernel<Half>(Opcode, Shadow, Shadow + Half, PartialPtr);
+    ReduceKernel<Half>(Opcode, PartialPtr, Res);
+  }
+}
+
+// Writes the shadows {x, x, x, 0} of Count values, with one vector store each
+template <typename ScalarT, typename ShadowT>
+void FillShadows(ScalarT const *Source, ShadowT *Res, size_t Count) {
+  using SampleT = std::remove_reference_t<decltype(Res->val[0])>;
+  using ShadowVector = simd::Vector_t<SampleT, 4>;
+  for (size_t I = 0; I < Count; I++) {
+    SampleT Value = static_cast<SampleT>(Source[I]);
+    ShadowVector Shadow = {Value, Value, Value, 0};
+    std::memcpy(&Res[I], &Shadow, sizeof(ShadowT));
+  }
+}
+
+
+} // namespace mcasync
+
+/* ========================================================================= */
+/* MCASync backend implementation                                            */
+/*                                                                           */
+/*                                                                           */
+/*                                                                           */
+/* ========================================================================= */
+
+using namespace mcasync;
+
+// Will either be MCAShadow128 or MCAShadow64 depending on FPType
+template <typename ShadowType>
+using MCASyncShadowFor =
+    typename std::conditional<std::is_same_v<OpaqueShadow, ShadowType>,
+                              MCASyncShadow, MCASyncLargeShadow>::type;
+
+template <typename MetaFloat>
+typename MetaFloat::FPType
+InsaneRuntime<MetaFloat>::Neg(FPType Operand, ShadowType **OperandShadow,
+                              ShadowType **Res) {
+
+  auto Shadow =
+      reinterpret_cast<MCASyncShadowFor<ShadowType> **>(OperandShadow);
+  auto ResShadow = reinterpret_cast<MCASyncShadowFor<ShadowType> **>(Res);
+
+  for (int I = 0; I < VectorSize; I++) {
+    ResShadow[I]->val[0] = -Shadow[I]->val[0];
+    ResShadow[I]->val[1] = -Shadow[I]->val[1];
+    ResShadow[I]->val[2] = -Shadow[I]->val[2];
+  }
+  return -Operand;
+}
+
+template <typename MetaFloat>
+typename MetaFloat::FPType
+InsaneRuntime<MetaFloat>::Add(FPType LeftOp, ShadowType **LeftOpaqueShadow,
+                              FPType RightOp, ShadowType **RightOpaqueShadow,
+                              ShadowType **Res) {
+
+  auto LeftShadow =
+      reinterpret_cast<MCASyncShadowFor<ShadowType> **>(LeftOpaqueShadow);
+  auto RightShadow =
+      reinterpret_cast<MCASyncShadowFor<ShadowType> **>(RightOpaqueShadow);
+  auto ResShadow = reinterpret_cast<MCASyncShadowFor<ShadowType> **>(Res);
+
+  // Perform every add in extended precision and add a rounding noise
+  BinaryKernel<simd::FAdd, VectorSize>(LeftShadow, RightShadow, ResShadow);
+  return LeftOp + RightOp;
+}
+
+template <typename MetaFloat>
+typename MetaFloat::FPType
+InsaneRuntime<MetaFloat>::Sub(FPType LeftOp, ShadowType **LeftOpaqueShadow,
+                              FPType RightOp, ShadowType **RightOpaqueShadow,
+                              ShadowType **Res) {
+
+  auto LeftShadow =
+      reinterpret_cast<MCASyncShadowFor<ShadowType> **>(LeftOpaqueShadow);
+  auto RightShadow =
+      reinterpret_cast<MCASyncShadowFor<ShadowType> **>(RightOpaqueShadow);
+  auto ResShadow = reinterpret_cast<MCASyncShadowFor<ShadowType> **>(Res);
+
+  // Perform every sub in extended precision and add a rounding noise
+  BinaryKernel<simd::FSub, VectorSize>(LeftShadow, RightShadow, ResShadow);
+  return LeftOp - RightOp;
+}
+
+template <typename MetaFloat>
+typename MetaFloat::FPType
+InsaneRuntime<MetaFloat>::Mul(FPType LeftOp, ShadowType **LeftOpaqueShadow,
+                              FPType RightOp, ShadowType **RightOpaqueShadow,
+                              ShadowType **Res) {
+
+  auto LeftShadow =
+      reinterpret_cast<MCASyncShadowFor<ShadowType> **>(LeftOpaqueShadow);
+  auto RightShadow =
+      reinterpret_cast<MCASyncShadowFor<ShadowType> **>(RightOpaqueShadow);
+  auto ResShadow = reinterpret_cast<MCASyncShadowFor<ShadowType> **>(Res);
+
+  // Perform every mul in extended precision and add a rounding noise
+  BinaryKernel<simd::FMul, VectorSize>(LeftShadow, RightShadow, ResShadow);
+  return LeftOp * RightOp;
+}
+
+template <typename MetaFloat>
+typename MetaFloat::FPType
+InsaneRuntime<MetaFloat>::Div(FPType LeftOp, ShadowType **LeftOpaqueShadow,
+                              FPType RightOp, ShadowType **RightOpaqueShadow,
+                              ShadowType **Res) {
+
+  auto LeftShadow =
+      reinterpret_cast<MCASyncShadowFor<ShadowType> **>(LeftOpaqueShadow);
+  auto RightShadow =
+      reinterpret_cast<MCASyncShadowFor<ShadowType> **>(RightOpaqueShadow);
+  auto ResShadow = reinterpret_cast<MCASyncShadowFor<ShadowType> **>(Res);
+
+  // Perform every div in extended precision and add a rounding noise
+  BinaryKernel<simd::FDiv, VectorSize>(LeftShadow, RightShadow, ResShadow);
+  return LeftOp / RightOp;
+}
+
+template <typename MetaFloat>
+typename MetaFloat::FPType InsaneRuntime<MetaFloat>::Binary(
+    simd::BinaryOpcode Opcode, FPType LeftOp, ShadowSpan<ShadowType> LeftSpan,
+    FPType RightOp, ShadowSpan<ShadowType> RightSpan,
+    ShadowSpan<ShadowType> ResSpan) {
+
+  constexpr size_t Contiguous = sizeof(MCASyncShadowFor<ShadowType>);
+  if constexpr (std::is_same_v<ShadowType, OpaqueShadow>) {
+    if (LeftSpan.Stride == Contiguous && RightSpan.Stride == Contiguous &&
+        ResSpan.Stride == Contiguous) {
+      auto *Left = reinterpret_cast<MCASyncShadow *>(LeftSpan.Base);
+      auto *Right = reinterpret_cast<MCASyncShadow *>(RightSpan.Base);
+      auto *Res = reinterpret_cast<MCASyncShadow *>(ResSpan.Base);
+      switch (Opcode) {
+      case simd::FAdd:
+        simd::Dispatch<BlockKernel<simd::FAdd, VectorSize>>(Left, Right, Res);
+        break;
+      case simd::FSub:
+        simd::Dispatch<BlockKernel<simd::FSub, VectorSize>>(Left, Right, Res);
+        break;
+      case simd::FMul:
+        simd::Dispatch<BlockKernel<simd::FMul, VectorSize>>(Left, Right, Res);
+        break;
+      case simd::FDiv:
+        simd::Dispatch<BlockKernel<simd::FDiv, VectorSize>>(Left, Right, Res);
+        break;
+      }
+      return simd::Apply(Opcode, LeftOp, RightOp);
+    }
+  }
+
+  // Non-contiguous, and large, shadows go through the pointer arrays
+  ShadowType *LeftShadow[VectorSize] = {}, *RightShadow[VectorSize] = {},
+             *ResShadow[VectorSize] = {};
+  LeftSpan.template gather<VectorSize>(LeftShadow);
+  RightSpan.template gather<VectorSize>(RightShadow);
+  ResSpan.template gather<VectorSize>(ResShadow);
+  switch (Opcode) {
+  case simd::FAdd:
+    return Add(LeftOp, LeftShadow, RightOp, RightShadow, ResShadow);
+  case simd::FSub:
+    return Sub(LeftOp, LeftShadow, RightOp, RightShadow, ResShadow);
+  case simd::FMul:
+    return Mul(LeftOp, LeftShadow, RightOp, RightShadow, ResShadow);
+  default:
+    return Div(LeftOp, LeftShadow, RightOp, RightShadow, ResShadow);
+  }
+}
+
+template <typename MetaFloat>
+typename MetaFloat::FPType InsaneRuntime<MetaFloat>::Fma(
+    FPType LeftOp, ShadowType **LeftOpaqueShadow, FPType RightOp,
+    ShadowType **RightOpaqueShadow, FPType AddendOp,
+    ShadowType **AddendOpaqueShadow, ShadowType **Res) {
+
+  auto LeftShadow =
+      reinterpret_cast<MCASyncShadowFor<ShadowType> **>(LeftOpaqueShadow);
+  auto RightShadow =
+      reinterpret_cast<MCASyncShadowFor<ShadowType> **>(RightOpaqueShadow);
+  auto AddendShadow =
+      reinterpret_cast<MCASyncShadowFor<ShadowType> **>(AddendOpaqueShadow);
+  auto ResShadow = reinterpret_cast<MCASyncShadowFor<ShadowType> **>(Res);
+
+  // A single rounding noise per sample, like the native fma
+  FmaKernel<VectorSize>(LeftShadow, RightShadow, AddendShadow, ResShadow);
+  return utils::fma(LeftOp, RightOp, AddendOp);
+}
+
+template <typename MetaFloat>
+typename MetaFloat::FPType
+InsaneRuntime<MetaFloat>::Math(MathOpcode Opcode, FPType Operand,
+                               ShadowType **OperandShadow, ShadowType **Res) {
+
+  auto Shadow =
+      reinterpret_cast<MCASyncShadowFor<ShadowType> **>(OperandShadow);
+  auto ResShadow = reinterpret_cast<MCASyncShadowFor<ShadowType> **>(Res);
+
+  // The operand is also passed as the unused second operand
+  MathKernel<VectorSize>(Opcode, Shadow, Shadow, ResShadow);
+  return ApplyMath(Opcode, Operand);
+}
+
+template <typename MetaFloat>
+typename MetaFloat::FPType
+InsaneRuntime<MetaFloat>::Pow(FPType LeftOp, ShadowType **LeftOpaqueShadow,
+                              FPType RightOp, ShadowType **RightOpaqueShadow,
+                              ShadowType **Res) {
+
+  auto LeftShadow =
+      reinterpret_cast<MCASyncShadowFor<ShadowType> **>(LeftOpaqueShadow);
+  auto RightShadow =
+      reinterpret_cast<MCASyncShadowFor<ShadowType> **>(RightOpaqueShadow);
+  auto ResShadow = reinterpret_cast<MCASyncShadowFor<ShadowType> **>(Res);
+
+  MathKernel<VectorSize>(Math_pow, LeftShadow, RightShadow, ResShadow);
+  return ApplyMath(Math_pow, LeftOp, RightOp);
+}
+
+template <typename MetaFloat>
+typename MetaFloat::ScalarType InsaneRuntime<MetaFloat>::Reduce(
+    ReduceOpcode Opcode, bool Reassoc, ScalarType Start,
+    ShadowType **StartOpaqueShadow, FPType Operand,
+    ShadowType **OperandShadow, ShadowType **Res) {
+
+  using MCASyncShadowType = MCASyncShadowFor<ShadowType>;
+  auto StartShadow =
+      reinterpret_cast<MCASyncShadowType **>(StartOpaqueShadow);
+  auto Shadow = reinterpret_cast<MCASyncShadowType **>(OperandShadow);
+  auto ResShadow = reinterpret_cast<MCASyncShadowType **>(Res);
+
+  // The samples follow the native order, so that they go through the same
+  // cancellations as the program
+  if (not Reassoc) {
+    MCASyncShadowType Accumulator = *StartShadow[0];
+    MCASyncShadowType *AccumulatorPtr = &Accumulator;
+    for (size_t I = 0; I < VectorSize; I++)
+      ReduceStepKernel<1>(Opcode, &AccumulatorPtr, &Shadow[I],
+                          &AccumulatorPtr);
+    *ResShadow[0] = Accumulator;
+    return ApplyReduce(Opcode, Reassoc, Start, Operand);
+  }
+
+  // The lanes are reduced first, then combined with the start value
+  MCASyncShadowType Reduced;
+  MCASyncShadowType *ReducedPtr = Shadow[0];
+  if constexpr (VectorSize > 1) {
+    ReducedPtr = &Reduced;
+    ReduceKernel<VectorSize>(Opcode, Shadow, &ReducedPtr);
+  }
+  ReduceStepKernel<1>(Opcode, StartShadow, &ReducedPtr, ResShadow);
+  return ApplyReduce(Opcode, Reassoc, Start, Operand);
+}
+
+template <typename MetaFloat>
+template <unsigned Policy>
+bool InsaneRuntime<MetaFloat>::Check(FPType Operand,
+                                     ShadowType **ShadowOperand) {
+  // Skipped outside of the regions of interest
+  if (not CheckingEnabled())
+    return false;
+
+  auto Shadow =
+      reinterpret_cast<MCASyncShadowFor<ShadowType> **>(ShadowOperand);
+
+  bool Res = 0;
+  // Vectors are checked lane-parallel
+  if constexpr (VectorSize > 1) {
+    Res = simd::Dispatch<
+        CheckLanesKernel<VectorSize, MCASyncShadowFor<ShadowType>>>(Shadow);
+    CountRegionCheck(Res);
+    return Res;
+  } else
+    Res = CheckInternal(Shadow[0]);
+  CountRegionCheck(Res);
+  if (Res) {
+    if (Reports<Policy>(Report_StackRecording))
+      InsaneContext::getInstance().getWarningRecorder().Record();
+
+    // Print a warning, formatting is done by the warning writer thread
+    if (Reports<Policy>(Report_Warnings)) {
+      WarningPayload Payload;
+      Payload.put(Operand);
+      Payload.put(*Shadow[0]);
+      WarningLog::getInstance().Push(
+          &FormatCheckFail<VectorSize, FPType, MCASyncShadowFor<ShadowType>>,
+          Payload);
+    }
+
+    if (Reports<Policy>(Report_ExitOnError))
+      exit(1);
+  }
+  return Res;
+}
+
+template <typename MetaFloat>
+template <FCmpOpcode Opcode, unsigned Policy>
+bool InsaneRuntime<MetaFloat>::CheckFCmp(FPType LeftOperand,
+                                         ShadowType **LeftShadowOperand,
+                                         FPType RightOperand,
+                                         ShadowType **RightShadowOperand,
+                                         bool Value) {
+  // Skipped outside of the regions of interest, the native result is kept
+  if (not CheckingEnabled())
+    return Value;
+
+  auto LeftShadow =
+      reinterpret_cast<MCASyncShadowFor<ShadowType> **>(LeftShadowOperand);
+  auto RightShadow =
+      reinterpret_cast<MCASyncShadowFor<ShadowType> **>(RightShadowOperand);
+  bool Res = FCmpInternal<Opcode, VectorSize>(LeftShadow, RightShadow);
+  CountRegionCheck(Value != Res);
+  // We expect both comparison to be equal, else we print an error
+  if (Value != Res) {
+    if (Reports<Policy>(Report_StackRecording))
+      InsaneContext::getInstance().getWarningRecorder().Record();
+
+    // Print a warning, formatting is done by the warning writer thread
+    if (Reports<Policy>(Report_Warnings)) {
+      WarningPayload Payload;
+      Payload.put(LeftOperand);
+      Payload.put(RightOperand);
+      for (int I = 0; I < VectorSize; I++)
+        Payload.put(*LeftShadow[I]);
+      for (int I = 0; I < VectorSize; I++)
+        Payload.put(*RightShadow[I]);
+      WarningLog::getInstance().Push(
+          &FormatFCmpCheckFail<VectorSize, FPType,
+                               MCASyncShadowFor<ShadowType>>,
+          Payload);
+    }
+
+    if (Reports<Policy>(Report_ExitOnError))
+      exit(1);
+  }
+  // We return the shadow comparison result to be able to correctly branch
+  return Res;
+}
+
+template <typename MetaFloat>
+void InsaneRuntime<MetaFloat>::CastToFloat(FPType,
+                                           ShadowType **OperandShadow,
+                                           OpaqueShadow **Res) {
+  auto Shadow =
+      reinterpret_cast<MCASyncShadowFor<ShadowType> **>(OperandShadow);
+  auto Destination = reinterpret_cast<MCASyncShadow **>(Res);
+
+  CastInternal<VectorSize>(Shadow, Destination);
+}
+
+template <typename MetaFloat>
+void InsaneRuntime<MetaFloat>::CastToDouble(FPType,
+                                            ShadowType **OperandShadow,
+                                            OpaqueLargeShadow **Res) {
+  auto Shadow =
+      reinterpret_cast<MCASyncShadowFor<ShadowType> **>(OperandShadow);
+  auto Destination = reinterpret_cast<MCASyncLargeShadow **>(Res);
+
+  CastInternal<VectorSize>(Shadow, Destination);
+}
+
+template <typename MetaFloat>
+void InsaneRuntime<MetaFloat>::CastToLongdouble(FPType,
+                                                ShadowType **OperandShadow,
+                                                OpaqueLargeShadow **Res) {
+  auto Shadow =
+      reinterpret_cast<MCASyncShadowFor<ShadowType> **>(OperandShadow);
+  auto Destination = reinterpret_cast<MCASyncLargeShadow **>(Res);
+
+  CastInternal<VectorSize>(Shadow, Destination);
+}
+
+template <typename MetaFloat>
+void InsaneRuntime<MetaFloat>::MakeShadowRange(ScalarType const *Source,
+                                               ShadowType *Res, size_t Count) {
+  using MCASyncShadowType = MCASyncShadowFor<ShadowType>;
+  simd::FillRange(Source, reinterpret_cast<MCASyncShadowType *>(Res), Count,
+                  FillShadows<ScalarType, MCASyncShadowType>);
+}
+
+template <typename MetaFloat>
+void InsaneRuntime<MetaFloat>::CopyShadowRange(ShadowType *Res,
+                                               ShadowType const *Source,
+                                               size_t Count) {
+  // glibc switches to non-temporal stores for large copies by itself
+  std::memmove(Res, Source, Count * sizeof(MCASyncShadowFor<ShadowType>));
+}
+
+template <typename MetaFloat>
+void InsaneRuntime<MetaFloat>::MakeShadow(FPType Source, ShadowType **Res) {
+
+  auto ResShadow = reinterpret_cast<MCASyncShadowFor<ShadowType> **>(Res);
+
+  for (int I = 0; I < VectorSize; I++) {
+    // We need a constexpr if to prevent the compiler from evaluating a[I]
+    // if its a scalar
+    if constexpr (VectorSize > 1) {
+      ResShadow[I]->val[0] = Source[I];
+      ResShadow[I]->val[1] = Source[I];
+      ResShadow[I]->val[2] = Source[I];
+    } else {
+      ResShadow[0]->val[0] = Source;
+      ResShadow[0]->val[1] = Source;
+      ResShadow[0]->val[2] = Source;
+    }
+  }
+}
+
+} // namespace insane
@@ -0,0 +1,189 @@
+/**
+ * @file AddressFilter.cpp
+ * @brief Callsite filters implementation
+ * @version 0.1.0
+ *
+ *
+ */
+
+#include "AddressFilter.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <elf.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <link.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace insane {
+
+namespace {
+
+using PatternList = std::vector<std::string>;
+
+bool Matches(PatternList const &Patterns, char const *Name) {
+  for (std::string const &Pattern : Patterns)
+    if (fnmatch(Pattern.c_str(), Name, 0) == 0)
+      return true;
+  return false;
+}
+
+struct RangeCollector {
+  PatternList const &Patterns;
+  std::vector<AddressRange> Ranges;
+};
+
+// Adds the functions of an ELF file matching the patterns, Base is the address
+// the file is loaded at
+void CollectSymbols(char const *Path, uintptr_t Base,
+                    RangeCollector &Collector) {
+  int File = open(Path, O_RDONLY | O_CLOEXEC);
+  if (File < 0)
+    return;
+  struct stat Status;
+  void *Mapping = MAP_FAILED;
+  if (fstat(File, &Status) == 0 && Status.st_size >= (off_t)sizeof(Elf64_Ehdr))
+    Mapping = mmap(nullptr, Status.st_size, PROT_READ, MAP_PRIVATE, File, 0);
+  close(File);
+  if (Mapping == MAP_FAILED)
+    return;
+
+  auto *Data = static_cast<char const *>(Mapping);
+  size_t Size = Status.st_size;
+  auto *Header = reinterpret_cast<Elf64_Ehdr const *>(Data);
+  if (memcmp(Header->e_ident, ELFMAG, SELFMAG) != 0 ||
+      Header->e_ident[EI_CLASS] != ELFCLASS64 ||
+      Header->e_shoff + Header->e_shnum * sizeof(Elf64_Shdr) > Size) {
+    munmap(Mapping, Size);
+    return;
+  }
+
+  // The full symbol table if the file is not stripped, else the dynamic one
+  auto *Sections = reinterpret_cast<Elf64_Shdr const *>(Data + Header->e_shoff);
+  Elf64_Shdr const *Symbols = nullptr;
+  for (size_t I = 0; I < Header->e_shnum; I++)
+    if (Sections[I].sh_type == SHT_SYMTAB ||
+        (Sections[I].sh_type == SHT_DYNSYM && Symbols == nullptr))
+      Symbols = &Sections[I];
+
+  if (Symbols != nullptr && Symbols->sh_link < Header->e_shnum &&
+      Symbols->sh_offset + Symbols->sh_size <= Size) {
+    Elf64_Shdr const &Strings = Sections[Symbols->sh_link];
+    auto *Begin = reinterpret_cast<Elf64_Sym const *>(Data + Symbols->sh_offset);
+    auto *End = Begin + Symbols->sh_size / sizeof(Elf64_Sym);
+    for (auto *Symbol = Begin; Symbol < End; Symbol++) {
+      if (ELF64_ST_TYPE(Symbol->st_info) != STT_FUNC || Symbol->st_size == 0 ||
+          Symbol->st_shndx == SHN_UNDEF || Symbol->st_name >= Strings.sh_size ||
+          Strings.sh_offset + Strings.sh_size > Size)
+        continue;
+      char const *Name = Data + Strings.sh_offset + Symbol->st_name;
+      if (Matches(Collector.Patterns, Name))
+        Collector.Ranges.push_back({Base + Symbol->st_value,
+                                    Base + Symbol->st_value + Symbol->st_size});
+    }
+  }
+  munmap(Mapping, Size);
+}
+
+int CollectModule(dl_phdr_info *Info, size_t, void *Data) {
+  auto &Collector = *static_cast<RangeCollector *>(Data);
+
+  // The main program has no name
+  char Path[4096];
+  if (Info->dlpi_name != nullptr && Info->dlpi_name[0] != '\0')
+    snprintf(Path, sizeof(Path), "%s", Info->dlpi_name);
+  else {
+    ssize_t Size = readlink("/proc/self/exe", Path, sizeof(Path) - 1);
+    Path[Size > 0 ? Size : 0] = '\0';
+  }
+  char const *Slash = strrchr(Path, '/');
+  char const *FileName = Slash ? Slash + 1 : Path;
+
+  if (Matches(Collector.Patterns, Path) ||
+      Matches(Collector.Patterns, FileName)) {
+    for (size_t I = 0; I < Info->dlpi_phnum; I++) {
+      ElfW(Phdr) const &Segment = Info->dlpi_phdr[I];
+      if (Segment.p_type == PT_LOAD && (Segment.p_flags & PF_X))
+        Collector.Ranges.push_back(
+            {Info->dlpi_addr + Segment.p_vaddr,
+             Info->dlpi_addr + Segment.p_vaddr + Segment.p_memsz});
+    }
+  } else if (Path[0] != '\0')
+    CollectSymbols(Path, Info->dlpi_addr, Collector);
+  return 0;
+}
+
+// Sorts and merges overlapping ranges
+void Normalize(std::vector<AddressRange> &Ranges) {
+  std::sort(Ranges.begin(), Ranges.end(),
+            [](AddressRange const &a, AddressRange const &b) {
+              return a.Begin < b.Begin;
+            });
+  size_t Merged = 0;
+  for (AddressRange const &Range : Ranges) {
+    if (Merged > 0 && Range.Begin <= Ranges[Merged - 1].End)
+      Ranges[Merged - 1].End = std::max(Ranges[Merged - 1].End, Range.End);
+    else
+      Ranges[Merged++] = Range;
+  }
+  Ranges.resize(Merged);
+}
+
+std::vector<AddressRange> CollectRanges(PatternList const &Patterns) {
+  RangeCollector Collector{Patterns, {}};
+  if (not Patterns.empty())
+    dl_iterate_phdr(&CollectModule, &Collector);
+  Normalize(Collector.Ranges);
+  return Collector.Ranges;
+}
+
+} // namespace
+
+void ConfigureAddressFilter(RuntimeFlags const &Flags) {
+  if (Flags.getCheckOnly().empty() && Flags.getSkip().empty())
+    return;
+
+  std::vector<AddressRange> Skipped = CollectRanges(Flags.getSkip());
+
+  // Everything around the check_only ranges is skipped
+  if (not Flags.getCheckOnly().empty()) {
+    uintptr_t Begin = 0;
+    for (AddressRange const &Range : CollectRanges(Flags.getCheckOnly())) {
+      if (Begin < Range.Begin)
+        Skipped.push_back({Begin, Range.Begin});
+      Begin = Range.End;
+    }
+    Skipped.push_back({Begin, UINTPTR_MAX});
+    Normalize(Skipped);
+  }
+
+  if (Flags.getVerbose())
+    fprintf(stderr, "[INSanE] %lu address range(s) are not checked\n",
+            Skipped.size());
+
+  // Never freed, the entries may be called until the very end
+  auto *Ranges = new AddressRange[Skipped.size()];
+  std::copy(Skipped.begin(), Skipped.end(), Ranges);
+  SkippedRanges = Ranges;
+  SkippedRangeCount = Skipped.size();
+}
+
+bool InSkippedRange(uintptr_t Address) {
+  // First range starting after Address, the previous one may contain it
+  size_t Low = 0, High = SkippedRangeCount;
+  while (Low < High) {
+    size_t Middle = (Low + High) / 2;
+    if (SkippedRanges[Middle].Begin <= Address)
+      Low = Middle + 1;
+    else
+      High = Middle;
+  }
+  return Low > 0 && Address < SkippedRanges[Low - 1].End;
+}
+
+} // namespace insane
@@ -0,0 +1,19 @@
+/**
+ * @file CheckElision.cpp
+ * @brief Per-callsite check elision implementation
+ * @version 0.1.0
+ *
+ *
+ */
+
+#include "CheckElision.hpp"
+
+namespace insane {
+
+void CheckElisionTable::Configure(RuntimeFlags const &Flags) {
+  Warmup = Flags.getCheckElisionWarmup();
+  MaxInterval = Flags.getCheckElisionMaxInterval();
+  Enabled = Flags.getCheckElision() && MaxInterval > 0;
+}
+
+} // namespace insane
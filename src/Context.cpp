@@ -9,6 +9,10 @@
  */
 
 #include "Context.hpp"
+#include "AddressFilter.hpp"
+#include "CheckElision.hpp"
+#include "Region.hpp"
+#include "Trace.hpp"
 
 namespace insane {
 
@@ -24,11 +28,28 @@ void InsaneContext::Init() {
   if (Initialized)
     return;
 
-  WRecorder = std::make_unique<StacktraceRecorder>();
   RTFlags.LoadFromEnvironnement();
   RTFlags.LoadFromFile(); // File config overrides env config
+  CheckElisionTable::getInstance().Configure(RTFlags);
+  ConfigureAddressFilter(RTFlags);
+  ConfigureTrace(RTFlags);
 
-  Initialized = true;
+  Initialized.store(true, std::memory_order_release);
+}
+
+unsigned ReportPolicyFor(RuntimeFlags const &Flags) {
+  unsigned Policy = Report_CountOnly;
+  if (Flags.getStackRecording())
+    Policy |= Report_StackRecording;
+  if (Flags.getWarningEnabled())
+    Policy |= Report_Warnings;
+  if (Flags.getExitOnError())
+    Policy |= Report_ExitOnError;
+  return Policy;
+}
+
+bool FlagsReport(ReportPolicy Feature) {
+  return ReportPolicyFor(InsaneContext::getInstance().Flags()) & Feature;
 }
 
 InsaneContext::~InsaneContext() {
@@ -40,8 +61,14 @@ InsaneContext::~InsaneContext() {
   if (not std::cerr.good())
     return;
 
-  if (RTFlags.getPrintStatsOnExit())
+  // Only used for its flags, as by a thread checking its region state
+  if (not Initialized)
+    return;
+
+  if (RTFlags.getPrintStatsOnExit()) {
     WRecorder->print(BackendName, std::cerr);
+    PrintRegionStats(std::cerr);
+  }
 
   BackendFinalize(*this);
 }
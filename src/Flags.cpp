@@ -67,7 +67,8 @@ bool RuntimeFlags::LoadFromFile(const std::string &Filename) {
 // Can only use printf during initialization
 void RuntimeFlags::ParseFlag(std::string const &Str) {
 
-  std::regex reg("(\\w*)\\s*=\\s*(\\w*)",
+  // Values end at a space or a comma, so that they may be paths or patterns
+  std::regex reg("(\\w*)\\s*=\\s*([^\\s,]*)",
                  std::regex::ECMAScript | std::regex::icase);
 
   auto FlagBegin = std::sregex_iterator(Str.begin(), Str.end(), reg);
@@ -96,7 +97,37 @@ void RuntimeFlags::ParseFlag(std::string const &Str) {
                 WarningLimit);
         WarningLimit = 0;
       }
-    } else
+    } else if (FlagName == "required_digits")
+      RequiredDigits = std::stoul(Value);
+    else if (FlagName == "async_warnings")
+      AsyncWarnings = (Value == "true");
+    else if (FlagName == "callsite_dedup")
+      CallsiteDedup = (Value == "true");
+    else if (FlagName == "callsite_frame_hash")
+      CallsiteFrameHash = (Value == "true");
+    else if (FlagName == "check_elision")
+      CheckElision = (Value == "true");
+    else if (FlagName == "check_elision_warmup")
+      CheckElisionWarmup = std::stoul(Value);
+    else if (FlagName == "check_elision_max_interval")
+      CheckElisionMaxInterval = std::stoul(Value);
+    else if (FlagName == "max_isa")
+      MaxISA = Value;
+    else if (FlagName == "regions_only")
+      RegionsOnly = (Value == "true");
+    else if (FlagName == "check_only")
+      CheckOnly.push_back(Value);
+    else if (FlagName == "skip")
+      Skip.push_back(Value);
+    else if (FlagName == "trace")
+      Trace = (Value == "true");
+    else if (FlagName == "trace_prefix")
+      TracePrefix = Value;
+    else if (FlagName == "trace_segment_size")
+      TraceSegmentSize = std::stoul(Value);
+    else if (FlagName == "trace_segments")
+      TraceSegments = std::stoul(Value);
+    else
       continue;
     RecognizedFlag++;
   }
@@ -1,11 +1,41 @@
 #!/usr/bin/python3
 
 # Python script to automatically generate the interface, since it is filled with boilerplate code
+# Usage: InterfaceGenerator.py [--inline-backend MCASync|DoublePrec]
+#                               [--mode static|plugin|loader|replay]
+#                               [--output File]
+
+import argparse
+import hashlib
+import io
+import re
 
 FPTypes = ["float", "double", "longdouble"]
 MaxVectorSize = {'float': 32, 'double': 16, 'longdouble': 1}
 ShadowType = ["OpaqueShadow", "OpaqueLargeShadow"]
 
+# Names and signatures of every generated entry point, in generation order
+# Plugins export them in this order, see Plugin.hpp
+EntryPoints = []
+
+# Entry points defined by the core, which are never traced
+CoreEntryPoints = {
+    # Called by nsan's runtime at startup
+    "__interflop_init": "extern \"C\" void __interflop_init()",
+    # See Region.hpp
+    "__insane_begin_region": "extern \"C\" void __insane_begin_region(char const *name)",
+    "__insane_end_region": "extern \"C\" void __insane_end_region()",
+    "__insane_set_checking": "extern \"C\" void __insane_set_checking(bool enabled)",
+}
+
+# Set with --inline-backend. Entries keyed by their callsite are then kept out
+# of line, see WriteEntry
+InlineEntries = False
+
+# Checks called through a member pointer, and the member they are bound to,
+# with the report policy left as {Policy}. See BindReportPolicy in Backend.hpp
+BoundChecks = []
+
 
 def GetVectorPrefix(VSize=1):
     if (VSize == 1):
@@ -36,38 +66,91 @@ def FPPrefix(Type: str, VSize=1):
     return res
 
 
-def WriteHeader(File=None):
+# Writes the signature of an entry point and opens its body
+# Callsite entries use __builtin_return_address(0) as the instrumented
+# callsite, for check elision, stacktrace dedup, callsite filters and trace
+# records. Once inlined under LTO, it would be the return address of the
+# instrumented function instead, so they are never inlined with
+# --inline-backend
+def WriteEntry(File, Signature: str, Trace=None, Callsite=False):
+    Name = re.search(r"(\w+)\(", Signature).group(1)
+    Index = len(EntryPoints)
+    EntryPoints.append((Name, Signature))
+    if Callsite and InlineEntries:
+        File.write(Signature.replace(
+            "extern \"C\" ", "extern \"C\" __attribute__((noinline)) ", 1))
+    else:
+        File.write(Signature)
+    File.write(" {\n")
+    WriteTrace(File, Index, Signature, Trace)
+
+
+# Records the call before running the backend, the parameters are written in
+# signature order unless a Trace call is given. See Trace.hpp
+def WriteTrace(File, Index: int, Signature: str, Trace=None):
+    File.write("\tif (TraceEnabled) {\n")
+    if Trace:
+        File.write(f"\t\t{Trace.format(Index=Index)};\n")
+    else:
+        _, Parameters, Names = SplitSignature(Signature)
+        # Scalar shadows are the only ones in signatures without a MetaFloat
+        VSize = re.search(r"MetaFloat<[\w ]+, (\d+)>|$", Signature).group(1)
+        File.write(
+            f"\t\tTraceRecord Record({Index}, __builtin_return_address(0));\n")
+        for Parameter, Name in zip(Parameters, Names):
+            if "Shadow**" in Parameter:
+                File.write(f"\t\tRecord.Shadows({Name}, {VSize});\n")
+            elif "Shadow" in Parameter:
+                File.write(f"\t\tRecord.Shadow({Name});\n")
+            elif Parameter.startswith("size_t"):
+                File.write(f"\t\tRecord.Size({Name});\n")
+            else:
+                File.write(f"\t\tRecord.Value({Name});\n")
+    File.write("\t}\n")
+
+
+# Declares the member pointer a check is called through, and returns its name
+def BindCheck(File, Name: str, Member: str):
+    Pointer = Name + "_bound"
+    BoundChecks.append((Pointer, Member))
+    File.write(
+        f"static auto {Pointer} = {Member.format(Policy='Report_FromFlags')};\n")
+    return Pointer
+
+
+# Loaders only accept plugins generated with the same signatures
+def InterfaceHash():
+    Signatures = "\n".join(Signature for _, Signature in EntryPoints)
+    return "0x" + hashlib.sha1(Signatures.encode()).hexdigest()[:16] + "ull"
+
+
+def WriteHeader(File=None, InlineBackend=None):
     File.write(
         "// This file was automatically generated by InterfaceGenerator.py\n")
     File.write("// Caution: Any changes made to this file will be erased\n\n")
-    File.write("#include \"Context.hpp\"\n\n")
+    File.write("#include \"AddressFilter.hpp\"\n")
+    File.write("#include \"CheckElision.hpp\"\n")
+    File.write("#include \"Context.hpp\"\n")
+    File.write("#include \"Plugin.hpp\"\n")
+    File.write("#include \"Region.hpp\"\n")
+    File.write("#include \"Trace.hpp\"\n")
+    # The backend template definitions are compiled along the interface, so
+    # that LTO can inline them in the instrumented code
+    if InlineBackend:
+        File.write(f"#include \"backends/{InlineBackend}Impl.hpp\"\n")
+    File.write("\n")
     File.write("#include <cstring>\n")
     File.write("using namespace insane;\n")
     File.write("template <typename T> using Backend = InsaneRuntime<T>;\n\n")
 
 
-def GenerateHelperFunction(File=None):
-    # Helper function to reduce a vector of bool to a single bool
-    File.write("namespace {"
-               "template < typename ScalarT, typename VectorT >\n"
-               "bool ReducePredicate(VectorT Vec) {\n"
-               "\tconstexpr size_t Size = sizeof(VectorT) / sizeof(ScalarT);\n"
-               "\tbool Res = true;\n"
-               "\tfor (int I=0; Res && (I < Size); I++)\n"
-               "\t\tRes = Res && Vec[I];\n"
-               "\treturn Res;\n"
-               "}\n"
-               "} // namespace\n\n")
-
-
 def GenerateConstructor(Type: str, VSize=1, File=None):
     MetaFloat = TypeToMetaFloat(Type, VSize)
     CType = MetaFloatToFpType(MetaFloat)
     ShadowType = FPTypeToShadow(Type, VSize)
     Prefix = FPPrefix(Type, VSize)
-    File.write(
+    WriteEntry(File,
         f"extern \"C\" void {Prefix}_make_shadow({CType} a, {ShadowType} sa)")
-    File.write(" {\n")
     File.write(f"\tBackend<{MetaFloat}> Backend;\n")
     if VSize == 1:
         File.write(f"\tBackend.MakeShadow(a, &sa);\n")
@@ -76,14 +159,34 @@ def GenerateConstructor(Type: str, VSize=1, File=None):
     File.write("}\n\n")
 
 
+def GenerateRangeConstructor(Type: str, File=None):
+    MetaFloat = TypeToMetaFloat(Type)
+    CType = MetaFloatToFpType(MetaFloat)
+    ShadowType = FPTypeToShadow(Type)
+    Prefix = FPPrefix(Type)
+
+    # sa is the shadow of a[0], the shadows of an array are contiguous
+    WriteEntry(File,
+        f"extern \"C\" void {Prefix}_make_shadow_range({CType} const *a, {ShadowType} sa, size_t n)",
+        "TraceShadowRange({Index}, __builtin_return_address(0), a, sa, n)")
+    File.write(f"\tBackend<{MetaFloat}> Backend;\n")
+    File.write(f"\tBackend.MakeShadowRange(a, sa, n);\n")
+    File.write("}\n\n")
+
+    WriteEntry(File,
+        f"extern \"C\" void {Prefix}_copy_shadow_range({ShadowType} res, {ShadowType.replace('*', ' const*')} sa, size_t n)")
+    File.write(f"\tBackend<{MetaFloat}> Backend;\n")
+    File.write(f"\tBackend.CopyShadowRange(res, sa, n);\n")
+    File.write("}\n\n")
+
+
 def GenerateUnary(Type: str, VSize=1, File=None):
     MetaFloat = TypeToMetaFloat(Type, VSize)
     CType = MetaFloatToFpType(MetaFloat)
     ShadowType = FPTypeToShadow(Type, VSize)
     Prefix = FPPrefix(Type, VSize)
-    File.write(
+    WriteEntry(File,
         f"extern \"C\" {CType} {Prefix}_neg({CType} a, {ShadowType} sa, {ShadowType} res)")
-    File.write(" {\n")
     File.write(f"\tBackend<{MetaFloat}> Backend;\n")
     if VSize == 1:
         File.write(f"\treturn Backend.Neg(a, &sa, &res);\n")
@@ -99,9 +202,8 @@ def GenerateBinary(Type: str, VSize=1, File=None):
     ShadowType = FPTypeToShadow(Type, VSize)
     Prefix = FPPrefix(Type, VSize)
     for Op in BinaryOps:
-        File.write(
+        WriteEntry(File,
             f"extern \"C\" {CType} {Prefix}_f{Op}({CType} a, {ShadowType} sa, {CType} b, {ShadowType} sb, {ShadowType} res)")
-        File.write(" {\n")
         File.write(f"\tBackend<{MetaFloat}> Backend;\n")
         Op = Op.capitalize()
         if VSize == 1:
@@ -111,6 +213,93 @@ def GenerateBinary(Type: str, VSize=1, File=None):
         File.write("}\n\n")
 
 
+# Same as GenerateBinary, with the lane shadows given as a first shadow and a
+# stride in bytes. Contiguous lanes are computed without gathering the shadows
+def GenerateStridedBinary(Type: str, VSize: int, File=None):
+    BinaryOps = ["add", "sub", "mul", "div"]
+    MetaFloat = TypeToMetaFloat(Type, VSize)
+    CType = MetaFloatToFpType(MetaFloat)
+    ShadowType = FPTypeToShadow(Type)
+    Prefix = FPPrefix(Type, VSize)
+    for Op in BinaryOps:
+        WriteEntry(File,
+            f"extern \"C\" {CType} {Prefix}_f{Op}_strided({CType} a, {ShadowType} sa, size_t sa_stride, {CType} b, {ShadowType} sb, size_t sb_stride, {ShadowType} res, size_t res_stride)")
+        File.write(f"\tBackend<{MetaFloat}> Backend;\n")
+        File.write(
+            f"\treturn Backend.Binary(simd::F{Op.capitalize()}, a, {{sa, sa_stride}}, b, {{sb, sb_stride}}, {{res, res_stride}});\n")
+        File.write("}\n\n")
+
+
+def GenerateFma(Type: str, VSize=1, File=None):
+    MetaFloat = TypeToMetaFloat(Type, VSize)
+    CType = MetaFloatToFpType(MetaFloat)
+    ShadowType = FPTypeToShadow(Type, VSize)
+    Prefix = FPPrefix(Type, VSize)
+    WriteEntry(File,
+        f"extern \"C\" {CType} {Prefix}_fma({CType} a, {ShadowType} sa, {CType} b, {ShadowType} sb, {CType} c, {ShadowType} sc, {ShadowType} res)")
+    File.write(f"\tBackend<{MetaFloat}> Backend;\n")
+    if VSize == 1:
+        File.write(f"\treturn Backend.Fma(a, &sa, b, &sb, c, &sc, &res);\n")
+    else:
+        File.write(f"\treturn Backend.Fma(a, sa, b, sb, c, sc, res);\n")
+    File.write("}\n\n")
+
+
+def GenerateMath(Type: str, VSize=1, File=None):
+    MathOps = ["sqrt", "exp", "log", "sin", "cos"]
+    MetaFloat = TypeToMetaFloat(Type, VSize)
+    CType = MetaFloatToFpType(MetaFloat)
+    ShadowType = FPTypeToShadow(Type, VSize)
+    Prefix = FPPrefix(Type, VSize)
+    for Op in MathOps:
+        WriteEntry(File,
+            f"extern \"C\" {CType} {Prefix}_{Op}({CType} a, {ShadowType} sa, {ShadowType} res)")
+        File.write(f"\tBackend<{MetaFloat}> Backend;\n")
+        if VSize == 1:
+            File.write(f"\treturn Backend.Math(Math_{Op}, a, &sa, &res);\n")
+        else:
+            File.write(f"\treturn Backend.Math(Math_{Op}, a, sa, res);\n")
+        File.write("}\n\n")
+
+    WriteEntry(File,
+        f"extern \"C\" {CType} {Prefix}_pow({CType} a, {ShadowType} sa, {CType} b, {ShadowType} sb, {ShadowType} res)")
+    File.write(f"\tBackend<{MetaFloat}> Backend;\n")
+    if VSize == 1:
+        File.write(f"\treturn Backend.Pow(a, &sa, b, &sb, &res);\n")
+    else:
+        File.write(f"\treturn Backend.Pow(a, sa, b, sb, res);\n")
+    File.write("}\n\n")
+
+
+def GenerateReduce(Type: str, VSize: int, File=None):
+    MetaFloat = TypeToMetaFloat(Type, VSize)
+    CType = MetaFloatToFpType(MetaFloat)
+    ScalarType = f"{MetaFloat}::ScalarType"
+    ShadowType = FPTypeToShadow(Type, VSize)
+    ScalarShadowType = FPTypeToShadow(Type)
+    Prefix = FPPrefix(Type, VSize)
+
+    # Same signatures as llvm.vector.reduce.*, fadd and fmul take a start value
+    # and are sequential unless the call has reassoc, see ApplyReduce
+    for Op in ["fadd", "fmul"]:
+        for Suffix, Reassoc in [("", "false"), ("_reassoc", "true")]:
+            WriteEntry(File,
+                f"extern \"C\" {ScalarType} {Prefix}_reduce_{Op}{Suffix}({ScalarType} start, {ScalarShadowType} sstart, {CType} a, {ShadowType} sa, {ScalarShadowType} res)")
+            File.write(f"\tBackend<{MetaFloat}> Backend;\n")
+            File.write(
+                f"\treturn Backend.Reduce(Reduce_{Op}, {Reassoc}, start, &sstart, a, sa, &res);\n")
+            File.write("}\n\n")
+
+    # The first lane is used as the start value
+    for Op in ["fmin", "fmax"]:
+        WriteEntry(File,
+            f"extern \"C\" {ScalarType} {Prefix}_reduce_{Op}({CType} a, {ShadowType} sa, {ScalarShadowType} res)")
+        File.write(f"\tBackend<{MetaFloat}> Backend;\n")
+        File.write(
+            f"\treturn Backend.Reduce(Reduce_{Op}, false, a[0], sa, a, sa, &res);\n")
+        File.write("}\n\n")
+
+
 def GenerateCheck(Type: str, File):
     BinaryOps = ["add", "sub", "mul", "div"]
     MetaFloat = TypeToMetaFloat(Type, 1)
@@ -118,35 +307,60 @@ def GenerateCheck(Type: str, File):
     ShadowType = FPTypeToShadow(Type)
     Prefix = FPPrefix(Type)
 
+    Pointer = BindCheck(File, f"{Prefix}_check",
+                        f"&Backend<{MetaFloat}>::Check<{{Policy}}>")
+
+    # Sites that keep passing are checked less often, see CheckElision.hpp
+    WriteEntry(File,
+        f"extern \"C\" int {Prefix}_check({CType} a, {ShadowType} sa)",
+        Callsite=True)
+    # Skipped before the elision, so that the sites outside of the regions of
+    # interest keep their history
+    File.write("\tif (not CheckingEnabled())\n")
+    File.write("\t\treturn 0;\n")
+    # Filtered sites, see AddressFilter.hpp
+    File.write("\tif (SkippedSite(__builtin_return_address(0)))\n")
+    File.write("\t\treturn 0;\n")
     File.write(
-        f"extern \"C\" int {Prefix}_check({CType} a, {ShadowType} sa)")
-    File.write(" {\n")
+        "\tauto *Site = CheckElisionTable::getInstance().Lookup(__builtin_return_address(0));\n")
+    File.write("\tif (Site && not Site->ShouldCheck())\n")
+    File.write("\t\treturn 0;\n")
     File.write(f"\tBackend<{MetaFloat}> Backend;\n")
-    File.write(f"\treturn Backend.Check(a, &sa);\n")
+    File.write(
+        "\tCallsiteScope Scope(__builtin_return_address(0), __builtin_frame_address(0));\n")
+    File.write(f"\tbool Res = (Backend.*{Pointer})(a, &sa);\n")
+    File.write("\tif (Site)\n")
+    File.write("\t\tSite->Report(Res, CheckElisionTable::getInstance());\n")
+    File.write("\treturn Res;\n")
     File.write("}\n\n")
 
 
 def GenerateFCmpCheck(Type: str, VSize: int, File):
     FCmpOps = ["oeq", "one", "ogt", "oge", "olt",
                "ole", "ueq", "une", "ugt", "uge", "ult", "ule"]
-    CmpOps = {"eq": "==", "ne": "!=", "gt": ">",
-              "ge": ">=", "lt": "<", "le": "<="}
     MetaFloat = TypeToMetaFloat(Type, VSize)
     CType = MetaFloatToFpType(MetaFloat)
     ShadowType = FPTypeToShadow(Type, VSize)
     Prefix = FPPrefix(Type, VSize)
 
+    # Vector comparisons hold if they hold on every lane
     for Op in FCmpOps:
-        File.write(
-            f"extern \"C\" int {Prefix}_fcmp_{Op}({CType} a, {ShadowType} sa, {CType} b, {ShadowType} sb)")
-        File.write(" {\n")
+        Pointer = BindCheck(File, f"{Prefix}_fcmp_{Op}",
+                            f"&Backend<{MetaFloat}>::CheckFCmp<FCmp_{Op}, {{Policy}}>")
+        WriteEntry(File,
+            f"extern \"C\" int {Prefix}_fcmp_{Op}({CType} a, {ShadowType} sa, {CType} b, {ShadowType} sb)",
+            Callsite=True)
+        File.write("\tif (SkippedSite(__builtin_return_address(0)))\n")
+        File.write(f"\t\treturn ReduceFCmp<FCmp_{Op}>(a, b);\n")
         File.write(f"\tBackend<{MetaFloat}> Backend;\n")
+        File.write(
+            "\tCallsiteScope Scope(__builtin_return_address(0), __builtin_frame_address(0));\n")
         if VSize == 1:
             File.write(
-                f"\treturn Backend.CheckFCmp(FCmp_{Op}, a, &sa, b, &sb, a {CmpOps[Op[1:]]} b);\n")
+                f"\treturn (Backend.*{Pointer})(a, &sa, b, &sb, ReduceFCmp<FCmp_{Op}>(a, b));\n")
         else:
             File.write(
-                f"\treturn Backend.CheckFCmp(FCmp_{Op}, a, sa, b, sb, ReducePredicate<{CType}>(a {CmpOps[Op[1:]]} b));\n")
+                f"\treturn (Backend.*{Pointer})(a, sa, b, sb, ReduceFCmp<FCmp_{Op}>(a, b));\n")
         File.write("}\n\n")
 
 
@@ -163,9 +377,8 @@ def GenerateCast(Type: str, VSize: int, File=None):
             continue
         ShadowDestType = FPTypeToShadow(DestType, VSize)
         Cast = "DownCast" if DestType == "float" else "UpCast"
-        File.write(
+        WriteEntry(File,
             f"extern \"C\" void {Prefix}_{DestType}_cast({CType} a, {ShadowType} sa, {ShadowDestType} res)")
-        File.write(" {\n")
         File.write(f"\tBackend<{MetaFloat}> Backend;\n")
         if VSize == 1:
             File.write(
@@ -176,20 +389,254 @@ def GenerateCast(Type: str, VSize: int, File=None):
         File.write("}\n\n")
 
 
-def GenerateInterface():
-    File = open("Interface.cpp", "w")
-    WriteHeader(File)
-    GenerateHelperFunction(File)
+def GenerateEntries(File):
+    EntryPoints.extend(CoreEntryPoints.items())
     for Type in FPTypes:
         VSize = 1
         GenerateCheck(Type, File)
+        GenerateRangeConstructor(Type, File)
         while VSize <= MaxVectorSize[Type]:
             GenerateConstructor(Type, VSize, File)
             GenerateUnary(Type, VSize, File)
             GenerateBinary(Type, VSize, File)
+            GenerateFma(Type, VSize, File)
+            GenerateMath(Type, VSize, File)
             GenerateFCmpCheck(Type, VSize, File)
             GenerateCast(Type, VSize, File)
+            if VSize > 1:
+                GenerateStridedBinary(Type, VSize, File)
+                GenerateReduce(Type, VSize, File)
             VSize *= 2
 
 
-GenerateInterface()
+# Binds every check to the specialization of the policy selected by the flags
+def GenerateBindReportPolicy(File):
+    File.write("void insane::BindReportPolicy(RuntimeFlags const &Flags) {\n")
+    File.write("\tWithReportPolicy(ReportPolicyFor(Flags), [](auto Policy) {\n")
+    for Pointer, Member in BoundChecks:
+        File.write(
+            f"\t\t{Pointer} = {Member.format(Policy='decltype(Policy)::value')};\n")
+    File.write("\t});\n")
+    File.write("}\n\n")
+
+
+# The function table of a backend plugin, the only symbol it exports
+def GeneratePluginTable(File):
+    File.write("extern \"C\" void __interflop_init();\n\n")
+    File.write("namespace {\n")
+    File.write("void *const Entries[] = {\n")
+    for Name, _ in EntryPoints:
+        File.write(f"\treinterpret_cast<void *>(&{Name}),\n")
+    File.write("};\n\n")
+    File.write(
+        f"PluginTable const Table = {{PluginABIVersion, {len(EntryPoints)}, {InterfaceHash()}, Entries}};\n")
+    File.write("} // namespace\n\n")
+    File.write(
+        "extern \"C\" __attribute__((visibility(\"default\"))) PluginTable const *__insane_plugin_table() {\n")
+    File.write("\treturn &Table;\n")
+    File.write("}\n")
+
+
+# Splits a signature into its return type, and the types and names of its
+# parameters. Parameter types may contain commas, as in MetaFloat<float, 4>
+def SplitSignature(Signature: str):
+    Name = re.search(r"(\w+)\(", Signature).group(1)
+    ReturnType = Signature[len("extern \"C\" "):Signature.index(Name)].strip()
+    Parameters = []
+    Depth = 0
+    Current = ""
+    for Char in Signature[Signature.index("(") + 1:Signature.rindex(")")]:
+        Depth += (Char == "<") - (Char == ">")
+        if Char == "," and Depth == 0:
+            Parameters.append(Current.strip())
+            Current = ""
+        else:
+            Current += Char
+    if Current.strip():
+        Parameters.append(Current.strip())
+    Names = [re.search(r"(\w+)$", Parameter).group(1) for Parameter in Parameters]
+    return ReturnType, Parameters, Names
+
+
+# Every entry point of the loader is an IFUNC, bound by the dynamic linker to
+# the function of the plugin the first time it is resolved.
+# Programs linked with immediate binding resolve them before plugins can be
+# loaded, they are then bound to a forwarder which loads the plugin on its
+# first call
+def GenerateLoader(File):
+    File.write(
+        "// This file was automatically generated by InterfaceGenerator.py\n")
+    File.write("// Caution: Any changes made to this file will be erased\n\n")
+    File.write("#include \"Backend.hpp\"\n")
+    File.write("#include \"Plugin.hpp\"\n\n")
+    File.write("using namespace insane;\n\n")
+    File.write("extern \"C\" {\n")
+    Count = len(EntryPoints)
+    for Index, (Name, Signature) in enumerate(EntryPoints):
+        ReturnType, Parameters, Names = SplitSignature(Signature)
+        File.write(f"static {ReturnType} {Name}_forward({', '.join(Parameters)}) {{\n")
+        File.write(
+            f"\treturn reinterpret_cast<decltype(&{Name}_forward)>(GetPluginEntry({Index}, {Count}, {InterfaceHash()}))({', '.join(Names)});\n")
+        File.write("}\n")
+        File.write(f"static decltype(&{Name}_forward) {Name}_resolver() {{\n")
+        File.write(
+            f"\treturn reinterpret_cast<decltype(&{Name}_forward)>(ResolvePluginEntry({Index}, {Count}, {InterfaceHash()}, reinterpret_cast<void *>(&{Name}_forward)));\n")
+        File.write("}\n")
+        File.write(
+            f"{ReturnType} {Name}({', '.join(Parameters)}) __attribute__((ifunc(\"{Name}_resolver\")));\n\n")
+    File.write("}\n\n")
+    # Once the program is relocated, so that the forwarders of immediate
+    # binding find the entries loaded
+    File.write("__attribute__((constructor)) static void LoadPlugin() {\n")
+    File.write(f"\tLoadPluginEntries({Count}, {InterfaceHash()});\n")
+    File.write("}\n")
+
+
+# Decodes a record in the order WriteTrace wrote it, and calls the entry of the
+# replayed backend. See Replay.hpp
+def GenerateReplayEntry(File, Index: int, Name: str, Signature: str, Indices):
+    _, Parameters, Names = SplitSignature(Signature)
+    Types = [Parameter[:-len(Name)].strip()
+             for Parameter, Name in zip(Parameters, Names)]
+    Type = re.match(r"__insane_([a-z]+)", Name).group(1)
+    ScalarType = "long double" if Type == "longdouble" else Type
+    VSize = re.search(r"MetaFloat<[\w ]+, (\d+)>|$", Signature).group(1)
+
+    File.write(f"// {Name}\n")
+    if Name.endswith("_make_shadow_range"):
+        File.write(
+            f"void Replay{Index}(ReplayContext &Context, uintptr_t, TracePayloadReader &Payload) {{\n")
+        File.write(
+            f"\tContext.MakeShadowRange<{ScalarType}, {FPTypeToShadow(Type)[:-1]}>(Payload);\n")
+        File.write("}\n\n")
+        return
+    if Name.endswith("_copy_shadow_range"):
+        File.write(
+            f"void Replay{Index}(ReplayContext &Context, uintptr_t, TracePayloadReader &Payload) {{\n")
+        File.write(f"\tContext.CopyShadowRange<{ScalarType}>(Payload);\n")
+        File.write("}\n\n")
+        return
+
+    # Strided operations call the vector entry with the lane shadows
+    Strided = Name.endswith("_strided")
+    Called = Indices[Name[:-len("_strided")]] if Strided else Index
+    ReturnType, CalledParameters, CalledNames = SplitSignature(
+        EntryPoints[Called][1])
+    CalledTypes = [Parameter[:-len(Name)].strip()
+                   for Parameter, Name in zip(CalledParameters, CalledNames)]
+    Counted = "_check" in Name or "_fcmp_" in Name
+    # The shadows of the other operands are inputs
+    Made = Name.endswith("_make_shadow")
+
+    Callsite = " Callsite" if Counted else ""
+    File.write(
+        f"void Replay{Index}(ReplayContext &Context, uintptr_t{Callsite}, TracePayloadReader &Payload) {{\n")
+    Values = []
+    Arguments = []
+    for Type, Name_ in zip(Types, Names):
+        if "Shadow" in Type:
+            Shadow = Type.replace("*", "").strip()
+            Value = Name_[1:] if Name_[1:] in Values and not Made else None
+            if "**" in Type or Strided:
+                Kind = "Strided" if Strided else ""
+                File.write(f"\t{Shadow} *{Name_}[{VSize}];\n")
+                if Value:
+                    File.write(
+                        f"\tContext.{Kind}Inputs(Payload, {Value}, {Name_}, {VSize});\n")
+                else:
+                    File.write(
+                        f"\tContext.{Kind}Outputs(Payload, {Name_}, {VSize});\n")
+            elif Value:
+                File.write(
+                    f"\tauto *{Name_} = Context.Input<{Shadow}>(Payload.Shadow(), {Value});\n")
+            else:
+                File.write(
+                    f"\tauto *{Name_} = Context.Output<{Shadow}>(Payload.Shadow());\n")
+        elif Type == "size_t":
+            # Strides are read along their shadow
+            if Strided:
+                continue
+            File.write(f"\tsize_t {Name_} = Payload.Size();\n")
+        else:
+            File.write(f"\t{Type} {Name_};\n")
+            File.write(f"\tPayload.Value({Name_});\n")
+            Values.append(Name_)
+        Arguments.append(Name_)
+
+    Call = f"reinterpret_cast<{ReturnType} (*)({', '.join(CalledTypes)})>(Context.Entries[{Called}])({', '.join(Arguments)})"
+    if not Counted:
+        File.write(f"\t{Call};\n")
+    elif "_fcmp_" in Name:
+        # Fails when the shadow comparison differs from the traced one
+        Opcode = Name.rsplit("_", 1)[1]
+        File.write(f"\tbool Res = {Call};\n")
+        File.write(
+            f"\tContext.Count(Callsite, Res != ReduceFCmp<FCmp_{Opcode}>(a, b));\n")
+    else:
+        File.write(f"\tContext.Count(Callsite, {Call} != 0);\n")
+    File.write("}\n\n")
+
+
+# Replay functions of every traced entry point, see Replay.hpp
+def GenerateReplay(File):
+    File.write(
+        "// This file was automatically generated by InterfaceGenerator.py\n")
+    File.write("// Caution: Any changes made to this file will be erased\n\n")
+    File.write("#include \"Replay.hpp\"\n\n")
+    File.write("using namespace insane;\n\n")
+    File.write("namespace {\n\n")
+    Indices = {Name: Index for Index, (Name, _) in enumerate(EntryPoints)}
+    Replayed = []
+    for Index, (Name, Signature) in enumerate(EntryPoints):
+        if Name in CoreEntryPoints:
+            Replayed.append("nullptr")
+            continue
+        GenerateReplayEntry(File, Index, Name, Signature, Indices)
+        Replayed.append(f"&Replay{Index}")
+    File.write("} // namespace\n\n")
+
+    File.write("ReplayFunction const insane::ReplayEntries[] = {\n")
+    for Function in Replayed:
+        File.write(f"\t{Function},\n")
+    File.write("};\n\n")
+    File.write(f"size_t const insane::ReplayEntryCount = {len(EntryPoints)};\n")
+    File.write(
+        f"uint64_t const insane::ReplayInterfaceHash = {InterfaceHash()};\n")
+    MakeShadow = ", ".join(str(Indices[f"__insane_{Type}_make_shadow"])
+                           for Type in FPTypes)
+    File.write(
+        f"size_t const insane::ReplayMakeShadowEntries[3] = {{{MakeShadow}}};\n")
+
+
+def GenerateInterface(Output, InlineBackend=None, Mode="static"):
+    if Mode == "loader":
+        # Only the list of entry points is needed
+        GenerateEntries(io.StringIO())
+        GenerateLoader(open(Output, "w"))
+        return
+    if Mode == "replay":
+        GenerateEntries(io.StringIO())
+        GenerateReplay(open(Output, "w"))
+        return
+
+    global InlineEntries
+    InlineEntries = InlineBackend is not None
+    File = open(Output, "w")
+    WriteHeader(File, InlineBackend)
+    GenerateEntries(File)
+    GenerateBindReportPolicy(File)
+    # Written in the header of trace segments, see Trace.hpp
+    File.write(
+        f"uint64_t const insane::TraceInterfaceHash = {InterfaceHash()};\n\n")
+    if Mode == "plugin":
+        GeneratePluginTable(File)
+
+
+Parser = argparse.ArgumentParser(description="Generates Interface.cpp")
+Parser.add_argument("--inline-backend", choices=["MCASync", "DoublePrec"],
+                    help="Expose this backend's template definitions to the interface")
+Parser.add_argument("--mode", choices=["static", "plugin", "loader", "replay"], default="static",
+                    help="Generate the interface of a backend plugin, of the plugin loader, or the trace replay")
+Parser.add_argument("--output", default="Interface.cpp")
+Args = Parser.parse_args()
+GenerateInterface(Args.output, Args.inline_backend, Args.mode)
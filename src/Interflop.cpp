@@ -10,27 +10,186 @@
 
 #include "Backend.hpp"
 #include "Context.hpp"
+#include "Simd.hpp"
 #include <atomic>
 #include <iomanip>
 #include <iostream>
+#include <mutex>
 
 namespace insane {
 
 void WarningRecorder::Record() {
   RecordImpl();
-  WarningCount++;
+  size_t Count = WarningCount.fetch_add(1, std::memory_order_relaxed) + 1;
 
   size_t WarningLimit = InsaneContext::getInstance().Flags().getWarningLimit();
 
-  if (WarningLimit > 0 && WarningCount > WarningLimit) {
+  if (WarningLimit > 0 && Count > WarningLimit) {
     std::cerr << "[INSanE] Warning limit reached, exiting\n";
     exit(1);
   }
 }
 
+namespace {
+
+// Shard of the current thread, registered on its first warning
+thread_local StacktraceRecorder::Shard LocalShard;
+
+// Taken before a recorder lock to change the owner of a shard. A recorder may
+// be destroyed while a thread exits, the owner is only dereferenced under this
+// lock, which is constant-initialized and outlives the recorders
+std::mutex OwnerMutex;
+
+} // namespace
+
+StacktraceRecorder::Shard::Shard() {
+  for (size_t I = 0; I < Capacity; I++) {
+    Keys[I].store(EmptyKey, std::memory_order_relaxed);
+    Counts[I].store(0, std::memory_order_relaxed);
+  }
+}
+
+// Merges the shard into its recorder on thread exit
+StacktraceRecorder::Shard::~Shard() {
+  std::scoped_lock<std::mutex> lock(OwnerMutex);
+  if (StacktraceRecorder *Recorder = Owner.load(std::memory_order_relaxed))
+    Recorder->Unregister(*this);
+}
+
+bool StacktraceRecorder::Shard::Increment(uint32_t StackId) {
+  if (StackId == EmptyKey)
+    return false;
+
+  // Fibonacci hashing, stack ids may be sequential
+  size_t Slot = (StackId * 0x9E3779B9u) >> 24;
+  static_assert(Capacity == 256, "Slot is computed for 256 entries");
+
+  for (size_t Probe = 0; Probe < Capacity; Probe++) {
+    size_t I = (Slot + Probe) & (Capacity - 1);
+    uint32_t Key = Keys[I].load(std::memory_order_relaxed);
+    if (Key == StackId) {
+      Counts[I].store(Counts[I].load(std::memory_order_relaxed) + 1,
+                      std::memory_order_relaxed);
+      return true;
+    }
+    if (Key == EmptyKey) {
+      // The count must be visible before the key to a merging thread
+      Counts[I].store(1, std::memory_order_relaxed);
+      Keys[I].store(StackId, std::memory_order_release);
+      return true;
+    }
+  }
+  return false;
+}
+
+uint32_t StacktraceRecorder::Shard::StackIdFor(Callsite const &Site) {
+  if (Site.Address == nullptr)
+    return utils::SaveStackTrace();
+
+  auto Key = reinterpret_cast<uintptr_t>(Site.Address) ^
+             reinterpret_cast<uintptr_t>(Site.Frame);
+  size_t Slot = (Key * 0x9E3779B97F4A7C15ull) >> 56;
+  static_assert(Capacity == 256, "Slot is computed for 256 entries");
+
+  for (size_t Probe = 0; Probe < Capacity; Probe++) {
+    size_t I = (Slot + Probe) & (Capacity - 1);
+    if (SiteAddresses[I] == Site.Address && SiteFrames[I] == Site.Frame)
+      return SiteStacks[I];
+    if (SiteAddresses[I] == nullptr) {
+      // Clang stack parsing should be thread safe
+      SiteStacks[I] = utils::SaveStackTrace();
+      SiteAddresses[I] = Site.Address;
+      SiteFrames[I] = Site.Frame;
+      return SiteStacks[I];
+    }
+  }
+  // Too many sites, the stack is unwound every time
+  return utils::SaveStackTrace();
+}
+
+StacktraceRecorder::~StacktraceRecorder() {
+  // Exiting threads must not merge into a destroyed recorder
+  std::scoped_lock lock(OwnerMutex, Mutex);
+  for (Shard *It = Shards; It != nullptr; It = It->Next)
+    It->Owner.store(nullptr, std::memory_order_relaxed);
+}
+
+uint32_t StacktraceRecorder::CurrentStackId() {
+  auto const &Flags = InsaneContext::getInstance().Flags();
+  Callsite Site;
+  if (Flags.getCallsiteDedup()) {
+    Site.Address = CurrentCallsite.Address;
+    if (Flags.getCallsiteFrameHash())
+      Site.Frame = CurrentCallsite.Frame;
+  }
+  return LocalShard.StackIdFor(Site);
+}
+
+void StacktraceRecorder::RecordImpl() {
+  if (LocalShard.Owner.load(std::memory_order_relaxed) != this) {
+    std::scoped_lock<std::mutex> lock(OwnerMutex);
+    if (StacktraceRecorder *Previous =
+            LocalShard.Owner.load(std::memory_order_relaxed))
+      Previous->Unregister(LocalShard);
+    Register(LocalShard);
+  }
+
+  uint32_t SId = CurrentStackId();
+
+  if (LocalShard.Increment(SId))
+    return;
+
+  // The shard is full
+  std::scoped_lock<std::mutex> lock(Mutex);
+  Map[SId]++;
+}
+
+void StacktraceRecorder::MergeShard(Shard const &Source, StackMap &Target) {
+  for (size_t I = 0; I < Shard::Capacity; I++) {
+    uint32_t Key = Source.Keys[I].load(std::memory_order_acquire);
+    if (Key != Shard::EmptyKey)
+      Target[Key] += Source.Counts[I].load(std::memory_order_relaxed);
+  }
+}
+
+void StacktraceRecorder::Register(Shard &Source) {
+  std::scoped_lock<std::mutex> lock(Mutex);
+  Source.Owner.store(this, std::memory_order_relaxed);
+  Source.Prev = nullptr;
+  Source.Next = Shards;
+  if (Shards)
+    Shards->Prev = &Source;
+  Shards = &Source;
+}
+
+void StacktraceRecorder::Unregister(Shard &Source) {
+  std::scoped_lock<std::mutex> lock(Mutex);
+  MergeShard(Source, Map);
+
+  if (Source.Prev)
+    Source.Prev->Next = Source.Next;
+  else
+    Shards = Source.Next;
+  if (Source.Next)
+    Source.Next->Prev = Source.Prev;
+
+  for (size_t I = 0; I < Shard::Capacity; I++) {
+    Source.Keys[I].store(Shard::EmptyKey, std::memory_order_relaxed);
+    Source.Counts[I].store(0, std::memory_order_relaxed);
+  }
+  Source.Owner.store(nullptr, std::memory_order_relaxed);
+  Source.Next = Source.Prev = nullptr;
+}
+
 void StacktraceRecorder::print(std::string const &BackendName,
                                std::ostream &out) {
   std::scoped_lock<std::mutex> lock(Mutex);
+
+  // Threads that are still running keep their shard, we merge a copy
+  StackMap Merged = Map;
+  for (Shard const *It = Shards; It != nullptr; It = It->Next)
+    MergeShard(*It, Merged);
+
   // Boilerplate printing code for recorded stacktraces
   out << "\n\n";
   for (int I = 0; I < 50; ++I)
@@ -40,17 +199,17 @@ void StacktraceRecorder::print(std::string const &BackendName,
       << "\n";
   out << "\tRuntime: " << BackendName << "\n";
   size_t WarningCount = 0;
-  for (auto const &It : Map)
+  for (auto const &It : Merged)
     WarningCount += It.second;
   out << "\tWarning(s): " << WarningCount << "\n";
   for (int I = 0; I < 50; ++I)
     out << "_";
   out << "\n";
 
-  if (Map.empty())
+  if (Merged.empty())
     out << "==[No warning emitted]==\n";
   out << utils::AsciiColor::Red;
-  for (auto const &It : Map) {
+  for (auto const &It : Merged) {
     // We need to flush the stream before printing the stack, or the stack
     // might appear before the warning
     out << It.second << " warning(s) at " << std::flush;
@@ -75,5 +234,25 @@ extern "C" void __interflop_init() {
 
   auto &Context = InsaneContext::getInstance();
   Context.Init();
+
+  // Kernels are selected before the backend, and any other thread, runs
+  simd::ISA MaxISA = simd::ISA::AVX512;
+  for (auto Value : {simd::ISA::Generic, simd::ISA::SSE42, simd::ISA::AVX2})
+    if (Context.Flags().getMaxISA() == simd::ISAName(Value))
+      MaxISA = Value;
+  simd::SelectISA(MaxISA);
+  if (simd::BelowBaseline(MaxISA))
+    fprintf(stderr,
+            "[INSanE] max_isa=%s is below the %s baseline of the build, "
+            "rebuild with an empty INSANE_BASELINE_FLAGS to limit the "
+            "instruction set\n",
+            simd::ISAName(MaxISA), simd::BaselineName);
+  if (Context.Flags().getVerbose())
+    fprintf(stderr, "[INSanE] Kernels use %s\n", simd::ISAName(simd::GetISA()));
+
+  // The checks no longer read the flags once bound
+  if (BindReportPolicy)
+    BindReportPolicy(Context.Flags());
+
   BackendInit(Context);
 }
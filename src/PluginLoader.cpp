@@ -0,0 +1,169 @@
+/**
+ * @file PluginLoader.cpp
+ * @brief Loads the backend plugin selected at startup
+ * @version 0.1.0
+ *
+ * Part of the interflop-loader library, which does not contain the core: the
+ * context, flags and recorders all live in the plugin.
+ *
+ */
+
+#include "Plugin.hpp"
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dlfcn.h>
+#include <unistd.h>
+
+namespace insane {
+
+namespace {
+
+constexpr size_t MaxPathSize = 4096;
+
+[[noreturn]] void LoadFailure(char const *Message, char const *Detail) {
+  fprintf(stderr, "[INSanE] %s: %s\n", Message, Detail);
+  _exit(EXIT_FAILURE);
+}
+
+// Same syntax as RuntimeFlags, "backend = value", but the value may be a path
+// The last occurrence wins
+void FindBackendOption(char const *Options, char *Value) {
+  constexpr char Name[] = "backend";
+  for (char const *It = strstr(Options, Name); It != nullptr;
+       It = strstr(It + 1, Name)) {
+    // Must not be the end of another flag name
+    if (It != Options && (isalnum(It[-1]) || It[-1] == '_'))
+      continue;
+
+    char const *Cursor = It + sizeof(Name) - 1;
+    while (isspace(*Cursor))
+      Cursor++;
+    if (*Cursor != '=')
+      continue;
+    Cursor++;
+    while (isspace(*Cursor))
+      Cursor++;
+
+    size_t Size = 0;
+    while (Cursor[Size] != '\0' && not isspace(Cursor[Size]) &&
+           Cursor[Size] != ',' && Size + 1 < MaxPathSize)
+      Size++;
+    memcpy(Value, Cursor, Size);
+    Value[Size] = '\0';
+  }
+}
+
+// With immediate binding, the resolvers of the program's relocations run
+// before the C library initializes environ
+void FindEnvironmentOption(char *Value) {
+  if (environ != nullptr) {
+    if (char const *Options = getenv("INSANE_OPTIONS"))
+      FindBackendOption(Options, Value);
+    return;
+  }
+
+  FILE *Environment = fopen("/proc/self/environ", "r");
+  if (Environment == nullptr)
+    return;
+  constexpr char Name[] = "INSANE_OPTIONS=";
+  static char Buffer[1 << 16];
+  size_t Size = fread(Buffer, 1, sizeof(Buffer) - 1, Environment);
+  Buffer[Size] = '\0';
+  fclose(Environment);
+  // Variables are separated by null characters
+  for (char const *It = Buffer; It < Buffer + Size; It += strlen(It) + 1)
+    if (strncmp(It, Name, sizeof(Name) - 1) == 0)
+      FindBackendOption(It + sizeof(Name) - 1, Value);
+}
+
+// The config file overrides the environment, like in InsaneContext::Init
+void GetBackendOption(char *Value) {
+  Value[0] = '\0';
+  FindEnvironmentOption(Value);
+
+  if (FILE *Config = fopen("insane_flags.cfg", "r")) {
+    static char Buffer[1 << 16];
+    size_t Size = fread(Buffer, 1, sizeof(Buffer) - 1, Config);
+    Buffer[Size] = '\0';
+    fclose(Config);
+    FindBackendOption(Buffer, Value);
+  }
+}
+
+// Backend names are looked up in the directory of the loader, paths are used
+// as is
+void GetPluginPath(char const *Backend, char *Path) {
+  if (strchr(Backend, '/') != nullptr) {
+    snprintf(Path, MaxPathSize, "%s", Backend);
+    return;
+  }
+
+  char Name[MaxPathSize];
+  size_t Size = 0;
+  for (; Backend[Size] != '\0'; Size++)
+    Name[Size] = tolower(Backend[Size]);
+  Name[Size] = '\0';
+
+  Dl_info Loader;
+  char const *Directory = ".";
+  int DirectorySize = 1;
+  if (dladdr(reinterpret_cast<void *>(&ResolvePluginEntry), &Loader) &&
+      Loader.dli_fname != nullptr) {
+    if (char const *Slash = strrchr(Loader.dli_fname, '/')) {
+      Directory = Loader.dli_fname;
+      DirectorySize = Slash - Loader.dli_fname;
+    }
+  }
+  if (snprintf(Path, MaxPathSize, "%.*s/libinterflop-%s-plugin.so",
+               DirectorySize, Directory, Name) >= int(MaxPathSize))
+    LoadFailure("The backend plugin path is too long", Name);
+}
+
+PluginTable const *LoadPlugin(uint32_t Count, uint64_t InterfaceHash) {
+  char Backend[MaxPathSize];
+  GetBackendOption(Backend);
+  if (Backend[0] == '\0')
+    LoadFailure("No backend selected",
+                "set backend=<name or path> in INSANE_OPTIONS");
+
+  char Path[MaxPathSize];
+  GetPluginPath(Backend, Path);
+  void *Handle = dlopen(Path, RTLD_NOW | RTLD_LOCAL);
+  if (Handle == nullptr)
+    LoadFailure("Cannot load the backend plugin", dlerror());
+
+  auto GetTable = reinterpret_cast<PluginTable const *(*)()>(
+      dlsym(Handle, "__insane_plugin_table"));
+  if (GetTable == nullptr)
+    LoadFailure("Not a backend plugin", Path);
+
+  PluginTable const *Table = GetTable();
+  if (Table->Version != PluginABIVersion || Table->Count != Count ||
+      Table->InterfaceHash != InterfaceHash)
+    LoadFailure("The backend plugin was generated from another interface",
+                Path);
+  return Table;
+}
+
+} // namespace
+
+std::atomic<void *const *> LoadedPluginEntries{nullptr};
+
+void *const *LoadPluginEntries(uint32_t Count, uint64_t InterfaceHash) {
+  // Lazy binding may resolve entries from several threads
+  static PluginTable const *Table = LoadPlugin(Count, InterfaceHash);
+  LoadedPluginEntries.store(Table->Entries, std::memory_order_release);
+  return Table->Entries;
+}
+
+void *ResolvePluginEntry(size_t Index, uint32_t Count, uint64_t InterfaceHash,
+                         void *Forward) {
+  // The C library initializes environ once the program is relocated
+  if (environ == nullptr)
+    return Forward;
+  return GetPluginEntry(Index, Count, InterfaceHash);
+}
+
+} // namespace insane
@@ -0,0 +1,286 @@
+/**
+ * @file Region.cpp
+ * @brief Regions of interest implementation
+ * @version 0.1.0
+ *
+ *
+ */
+
+#include "Region.hpp"
+#include "Context.hpp"
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace insane {
+
+namespace {
+
+struct RegionInfo {
+  std::string Name;
+  std::atomic<uint64_t> Entries{0};
+  std::atomic<uint64_t> Checks{0};
+  std::atomic<uint64_t> Failures{0};
+  std::atomic<uint64_t> Roundings{0};
+  std::atomic<uint64_t> ExactRoundings{0};
+
+  explicit RegionInfo(char const *Name) : Name(Name) {}
+};
+
+// Counts not yet added to a region
+struct PendingCounts {
+  uint64_t Checks;
+  uint64_t Failures;
+  uint64_t Roundings;
+  uint64_t ExactRoundings;
+};
+
+// Regions are never removed, so that threads keep pointers to them
+// Region ids index Regions from 1
+class RegionTable {
+public:
+  // Never destroyed, threads still running after the exit flush into it
+  static RegionTable &getInstance() {
+    static RegionTable &Table = *new RegionTable;
+    return Table;
+  }
+
+  RegionInfo &Lookup(char const *Name, uint32_t &Id) {
+    std::scoped_lock<std::mutex> lock(Mutex);
+    auto [It, Inserted] = Ids.try_emplace(Name, Regions.size() + 1);
+    if (Inserted)
+      Regions.emplace_back(Name);
+    Id = It->second;
+    return Regions[Id - 1];
+  }
+
+  char const *Name(uint32_t Id) {
+    std::scoped_lock<std::mutex> lock(Mutex);
+    return Regions[Id - 1].Name.c_str();
+  }
+
+  void Print(std::ostream &Out,
+             std::unordered_map<RegionInfo const *, PendingCounts> &Pending) {
+    std::scoped_lock<std::mutex> lock(Mutex);
+    if (Regions.empty())
+      return;
+    Out << "\tRegions:\n";
+    for (RegionInfo const &Info : Regions) {
+      PendingCounts Counts = Pending[&Info];
+      uint64_t Roundings = Info.Roundings + Counts.Roundings;
+      Out << "\t  " << Info.Name << ": " << Info.Entries << " entries, "
+          << Info.Checks + Counts.Checks << " checks, "
+          << Info.Failures + Counts.Failures << " failed";
+      if (Roundings > 0)
+        Out << ", " << Roundings << " roundings ("
+            << Info.ExactRoundings + Counts.ExactRoundings << " exact)";
+      Out << "\n";
+    }
+  }
+
+private:
+  RegionTable() = default;
+
+  std::mutex Mutex;
+  std::unordered_map<std::string, uint32_t> Ids;
+  std::deque<RegionInfo> Regions;
+};
+
+// Regions nested deeper are counted in the innermost tracked one
+constexpr uint32_t MaxRegionDepth = 64;
+
+struct RegionStack {
+  uint32_t Ids[MaxRegionDepth];
+  RegionInfo *Infos[MaxRegionDepth];
+  uint32_t Depth;
+};
+
+thread_local RegionStack LocalRegions;
+
+// Names are usually literals, looked up by address before taking the lock
+constexpr size_t RegionCacheSize = 8;
+
+struct CachedRegion {
+  char const *Name;
+  RegionInfo *Info;
+  uint32_t Id;
+};
+
+thread_local CachedRegion RegionCache[RegionCacheSize];
+thread_local size_t NextCachedRegion;
+
+RegionInfo &LookupRegion(char const *Name, uint32_t &Id) {
+  for (CachedRegion const &Cached : RegionCache)
+    if (Cached.Name == Name && Cached.Info->Name == Name) {
+      Id = Cached.Id;
+      return *Cached.Info;
+    }
+
+  RegionInfo &Info = RegionTable::getInstance().Lookup(Name, Id);
+  RegionCache[NextCachedRegion] = {Name, &Info, Id};
+  NextCachedRegion = (NextCachedRegion + 1) % RegionCacheSize;
+  return Info;
+}
+
+uint32_t TrackedDepth() {
+  return std::min(LocalRegions.Depth, MaxRegionDepth);
+}
+
+RegionInfo *InnermostRegion() {
+  if (LocalRegions.Depth == 0)
+    return nullptr;
+  return LocalRegions.Infos[TrackedDepth() - 1];
+}
+
+void FlushCounter(std::atomic<uint64_t> &Local, std::atomic<uint64_t> *Global) {
+  uint64_t Value = Local.exchange(0, std::memory_order_relaxed);
+  if (Global)
+    Global->fetch_add(Value, std::memory_order_relaxed);
+}
+
+// Adds the counters of the thread to its innermost region, counts outside of
+// any region are dropped
+void FlushRegionCounters() {
+  RegionInfo *Info = InnermostRegion();
+  FlushCounter(LocalRegionCounters.Checks, Info ? &Info->Checks : nullptr);
+  FlushCounter(LocalRegionCounters.Failures, Info ? &Info->Failures : nullptr);
+  FlushCounter(LocalRegionCounters.Roundings,
+               Info ? &Info->Roundings : nullptr);
+  FlushCounter(LocalRegionCounters.ExactRoundings,
+               Info ? &Info->ExactRoundings : nullptr);
+}
+
+// Threads that entered a region, registered so that the statistics include
+// the counts they have not flushed yet. Constant-initialized, usable while
+// other threads exit during the static destruction
+struct RegionThread;
+std::mutex ThreadsMutex;
+RegionThread *Threads = nullptr;
+
+struct RegionThread {
+  RegionCounters *Counters = &LocalRegionCounters;
+  std::atomic<RegionInfo *> Innermost{nullptr};
+  RegionThread *Prev = nullptr;
+  RegionThread *Next = nullptr;
+
+  RegionThread() {
+    std::scoped_lock<std::mutex> lock(ThreadsMutex);
+    Next = Threads;
+    if (Next)
+      Next->Prev = this;
+    Threads = this;
+  }
+
+  // Flushes the counts of an exiting thread
+  ~RegionThread() {
+    std::scoped_lock<std::mutex> lock(ThreadsMutex);
+    FlushRegionCounters();
+    if (Prev)
+      Prev->Next = Next;
+    else
+      Threads = Next;
+    if (Next)
+      Next->Prev = Prev;
+  }
+};
+
+thread_local RegionThread LocalThread;
+
+// Counts of the threads still running, by innermost region
+std::unordered_map<RegionInfo const *, PendingCounts> CollectPendingCounts() {
+  std::unordered_map<RegionInfo const *, PendingCounts> Pending;
+  for (RegionThread *Thread = Threads; Thread; Thread = Thread->Next) {
+    RegionInfo *Info = Thread->Innermost.load(std::memory_order_relaxed);
+    if (Info == nullptr)
+      continue;
+    RegionCounters const &Counters = *Thread->Counters;
+    PendingCounts &Counts = Pending[Info];
+    Counts.Checks += Counters.Checks.load(std::memory_order_relaxed);
+    Counts.Failures += Counters.Failures.load(std::memory_order_relaxed);
+    Counts.Roundings += Counters.Roundings.load(std::memory_order_relaxed);
+    Counts.ExactRoundings +=
+        Counters.ExactRoundings.load(std::memory_order_relaxed);
+  }
+  return Pending;
+}
+
+// The flags are the defaults before the context initialization, the state is
+// then left uninitialized to be updated on the next check
+void UpdateRegionState() {
+  InsaneContext &Context = InsaneContext::getInstance();
+  uint32_t State = RegionState & Region_Disabled;
+  if (Context.isInitialized())
+    State |= Region_Initialized;
+  if (LocalRegions.Depth == 0 && Context.Flags().getRegionsOnly())
+    State |= Region_Outside;
+  RegionState = State;
+}
+
+} // namespace
+
+bool InitRegionState() {
+  UpdateRegionState();
+  return (RegionState & (Region_Outside | Region_Disabled)) == 0;
+}
+
+uint32_t CurrentRegion() {
+  if (LocalRegions.Depth == 0)
+    return 0;
+  return LocalRegions.Ids[TrackedDepth() - 1];
+}
+
+char const *RegionName(uint32_t Id) {
+  if (Id == 0)
+    return nullptr;
+  return RegionTable::getInstance().Name(Id);
+}
+
+void PrintRegionStats(std::ostream &Out) {
+  std::scoped_lock<std::mutex> lock(ThreadsMutex);
+  auto Pending = CollectPendingCounts();
+  RegionTable::getInstance().Print(Out, Pending);
+}
+
+} // namespace insane
+
+using namespace insane;
+
+extern "C" void __insane_begin_region(char const *name) {
+  if (name == nullptr)
+    name = "";
+  FlushRegionCounters();
+
+  uint32_t Id;
+  RegionInfo &Info = LookupRegion(name, Id);
+  Info.Entries.fetch_add(1, std::memory_order_relaxed);
+  if (LocalRegions.Depth < MaxRegionDepth) {
+    LocalRegions.Ids[LocalRegions.Depth] = Id;
+    LocalRegions.Infos[LocalRegions.Depth] = &Info;
+  }
+  LocalRegions.Depth++;
+  LocalThread.Innermost.store(InnermostRegion(), std::memory_order_relaxed);
+  UpdateRegionState();
+}
+
+extern "C" void __insane_end_region() {
+  // Unmatched ends are ignored
+  if (LocalRegions.Depth == 0)
+    return;
+
+  FlushRegionCounters();
+  LocalRegions.Depth--;
+  LocalThread.Innermost.store(InnermostRegion(), std::memory_order_relaxed);
+  UpdateRegionState();
+}
+
+extern "C" void __insane_set_checking(bool enabled) {
+  if (not(RegionState & Region_Initialized))
+    UpdateRegionState();
+  if (enabled)
+    RegionState &= ~Region_Disabled;
+  else
+    RegionState |= Region_Disabled;
+}
@@ -0,0 +1,365 @@
+/**
+ * @file Replay.cpp
+ * @brief insane-replay, replays traces against a backend plugin
+ * @version 0.1.0
+ *
+ * Usage: insane-replay [options] <segment files>
+ *   --backend <name or path>  Plugin to replay with, as the backend option of
+ *                             the loader. Defaults to mcasync
+ *   --samples <N>             Independent replays of the trace, 1 by default
+ *   --jobs <N>                Worker threads, one per core by default
+ *   --split-segments          Replays the segments of a thread independently
+ *   --shadow-scale <N>        Shadow scale expected by the backend, known for
+ *                             mcasync and doubleprec
+ *
+ * A task replays the segments of one traced thread for one sample. With
+ * --split-segments, each segment is a task of its own, and starts from the
+ * recorded values, losing the shadows computed before it.
+ *
+ * The plugin reads INSANE_OPTIONS as usual. Errors neither exit nor print
+ * warnings, nor stop at the warning limit, unless set otherwise, and tracing
+ * is always disabled.
+ */
+
+#include "Plugin.hpp"
+#include "Replay.hpp"
+#include "WorkStealing.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <dlfcn.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace insane {
+
+char *ReplayShadows::Allocate() {
+  if (not Free.empty()) {
+    char *Slot = Free.back();
+    Free.pop_back();
+    return Slot;
+  }
+  if (BlockUsed == BlockSlots) {
+    Blocks.emplace_back(static_cast<char *>(
+        std::aligned_alloc(SlotSize, SlotSize * BlockSlots)));
+    BlockUsed = 0;
+  }
+  return Blocks.back().get() + SlotSize * BlockUsed++;
+}
+
+} // namespace insane
+
+using namespace insane;
+
+// The plugins call nsan's runtime, which the replay stands in for
+namespace {
+size_t ReplayShadowScale = 4;
+} // namespace
+
+void __nsan_dump_stacktrace() {}
+
+uint32_t __nsan_save_stacktrace() { return 0; }
+
+void __nsan_print_stacktrace(uint32_t) {}
+
+size_t __nsan_get_shadowscale() { return ReplayShadowScale; }
+
+namespace {
+
+struct ReplayOptions {
+  std::string Backend = "mcasync";
+  unsigned Samples = 1;
+  unsigned Jobs = std::max(std::thread::hardware_concurrency(), 1u);
+  bool SplitSegments = false;
+  size_t ShadowScale = 0;
+  std::vector<std::string> Segments;
+};
+
+[[noreturn]] void Usage(char const *Program) {
+  fprintf(stderr,
+          "Usage: %s [--backend <name or path>] [--samples N] [--jobs N] "
+          "[--split-segments] [--shadow-scale N] <segment files>\n",
+          Program);
+  exit(EXIT_FAILURE);
+}
+
+ReplayOptions ParseOptions(int argc, char **argv) {
+  ReplayOptions Options;
+  for (int I = 1; I < argc; I++) {
+    std::string Option = argv[I];
+    bool HasValue = I + 1 < argc;
+    if (Option == "--backend" && HasValue)
+      Options.Backend = argv[++I];
+    else if (Option == "--samples" && HasValue)
+      Options.Samples = std::max(std::stoul(argv[++I]), 1ul);
+    else if (Option == "--jobs" && HasValue)
+      Options.Jobs = std::max(std::stoul(argv[++I]), 1ul);
+    else if (Option == "--shadow-scale" && HasValue)
+      Options.ShadowScale = std::stoul(argv[++I]);
+    else if (Option == "--split-segments")
+      Options.SplitSegments = true;
+    else if (Option.rfind("--", 0) == 0)
+      Usage(argv[0]);
+    else
+      Options.Segments.push_back(Option);
+  }
+  if (Options.Segments.empty())
+    Usage(argv[0]);
+
+  if (Options.ShadowScale == 0)
+    Options.ShadowScale = (Options.Backend == "doubleprec") ? 2 : 4;
+  return Options;
+}
+
+// Backend names are looked up next to the executable and in the library
+// directory of the build, paths are used as is
+void *const *LoadPlugin(std::string const &Backend) {
+  std::vector<std::string> Candidates;
+  if (Backend.find('/') != std::string::npos)
+    Candidates.push_back(Backend);
+  else {
+    char Executable[4096];
+    ssize_t Size = readlink("/proc/self/exe", Executable, sizeof(Executable) - 1);
+    Executable[Size > 0 ? Size : 0] = '\0';
+    std::string Directory = Executable;
+    Directory = Directory.substr(0, Directory.rfind('/') + 1);
+    std::string Name = "libinterflop-" + Backend + "-plugin.so";
+    Candidates = {Directory + Name, Directory + "../lib/" + Name};
+  }
+
+  for (std::string const &Path : Candidates) {
+    void *Handle = dlopen(Path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (Handle == nullptr)
+      continue;
+    auto Table = reinterpret_cast<decltype(&__insane_plugin_table)>(
+        dlsym(Handle, "__insane_plugin_table"));
+    PluginTable const *Plugin = Table ? Table() : nullptr;
+    if (Plugin == nullptr || Plugin->Version != PluginABIVersion ||
+        Plugin->Count != ReplayEntryCount ||
+        Plugin->InterfaceHash != ReplayInterfaceHash) {
+      fprintf(stderr, "[INSanE] %s does not match the replay's interface\n",
+              Path.c_str());
+      exit(EXIT_FAILURE);
+    }
+    return Plugin->Entries;
+  }
+  fprintf(stderr, "[INSanE] Cannot load the %s backend: %s\n",
+          Backend.c_str(), dlerror());
+  exit(EXIT_FAILURE);
+}
+
+// Errors and warnings are left to the replay summary, the user's options
+// come after the defaults so that they win, but the replay is never traced
+void SetPluginOptions() {
+  std::string Options = "exit_on_error=false warning_enabled=false "
+                        "warning_limit=0 stack_recording=false "
+                        "print_stats_on_exit=false ";
+  if (char const *User = getenv("INSANE_OPTIONS"))
+    Options += User;
+  Options += " trace=false";
+  setenv("INSANE_OPTIONS", Options.c_str(), 1);
+}
+
+struct Segment {
+  uint32_t Index;
+  std::string Path;
+};
+
+// Segments of one traced thread, in order
+struct ThreadTrace {
+  uint32_t Process;
+  uint32_t Thread;
+  std::vector<Segment> Segments;
+};
+
+std::vector<ThreadTrace> GroupSegments(std::vector<std::string> const &Paths,
+                                       uint32_t &TraceScale) {
+  std::map<std::pair<uint32_t, uint32_t>, ThreadTrace> Threads;
+  TraceScale = 0;
+  for (std::string const &Path : Paths) {
+    std::string Error;
+    TraceReader Reader(Path, Error);
+    if (not Reader.valid()) {
+      fprintf(stderr, "[INSanE] %s\n", Error.c_str());
+      exit(EXIT_FAILURE);
+    }
+    TraceFileHeader const &Header = Reader.header();
+    if (Header.InterfaceHash != ReplayInterfaceHash) {
+      fprintf(stderr,
+              "[INSanE] %s was recorded with another interface, rebuild "
+              "insane-replay from the traced program's sources\n",
+              Path.c_str());
+      exit(EXIT_FAILURE);
+    }
+    if (TraceScale != 0 && TraceScale != Header.ShadowScale) {
+      fprintf(stderr, "[INSanE] Segments come from different programs\n");
+      exit(EXIT_FAILURE);
+    }
+    TraceScale = Header.ShadowScale;
+
+    ThreadTrace &Thread = Threads[{Header.Process, Header.Thread}];
+    Thread.Process = Header.Process;
+    Thread.Thread = Header.Thread;
+    Thread.Segments.push_back({Header.Segment, Path});
+  }
+
+  std::vector<ThreadTrace> Traces;
+  for (auto &[Key, Thread] : Threads) {
+    std::sort(Thread.Segments.begin(), Thread.Segments.end(),
+              [](Segment const &a, Segment const &b) {
+                return a.Index < b.Index;
+              });
+    uint32_t Expected = Thread.Segments.front().Index;
+    if (Expected != 0)
+      fprintf(stderr,
+              "[INSanE] Thread %u of process %u starts at segment %u, earlier "
+              "ones were rotated out\n",
+              Thread.Thread, Thread.Process, Expected);
+    for (Segment const &Current : Thread.Segments)
+      if (Current.Index != Expected++) {
+        fprintf(stderr, "[INSanE] Segment %u of thread %u is missing\n",
+                Expected - 1, Thread.Thread);
+        Expected = Current.Index + 1;
+      }
+    Traces.push_back(std::move(Thread));
+  }
+  return Traces;
+}
+
+// Counts of a callsite over every sample
+struct CallsiteSummary {
+  uint64_t Checks = 0;
+  uint64_t Failures = 0;
+  std::vector<bool> FailedSamples;
+};
+
+class ReplayResults {
+public:
+  explicit ReplayResults(unsigned Samples) : Samples(Samples) {}
+
+  void Merge(unsigned Sample, ReplayContext const &Context, uint64_t Records,
+             uint64_t Unknown) {
+    std::scoped_lock<std::mutex> lock(Mutex);
+    this->Records += Records;
+    this->Unknown += Unknown;
+    for (auto const &[Callsite, Counts] : Context.callsites()) {
+      CallsiteSummary &Summary = Callsites[Callsite];
+      Summary.Checks += Counts.Checks;
+      Summary.Failures += Counts.Failures;
+      Summary.FailedSamples.resize(Samples);
+      if (Counts.Failures > 0)
+        Summary.FailedSamples[Sample] = true;
+    }
+  }
+
+  void Print(double Seconds, size_t Threads, char const *Backend) const {
+    fprintf(stderr,
+            "[INSanE] Replayed %lu operation(s) of %lu thread(s), %u "
+            "sample(s) with %s in %.2fs\n",
+            Records, Threads, Samples, Backend, Seconds);
+    if (Unknown > 0)
+      fprintf(stderr, "[INSanE] %lu record(s) could not be replayed\n",
+              Unknown);
+
+    // Callsites failing in most samples first
+    std::vector<std::pair<uintptr_t, CallsiteSummary const *>> Sorted;
+    for (auto const &[Callsite, Summary] : Callsites)
+      Sorted.emplace_back(Callsite, &Summary);
+    auto FailedSamples = [](CallsiteSummary const &Summary) {
+      return std::count(Summary.FailedSamples.begin(),
+                        Summary.FailedSamples.end(), true);
+    };
+    std::sort(Sorted.begin(), Sorted.end(), [&](auto const &a, auto const &b) {
+      auto Left = FailedSamples(*a.second), Right = FailedSamples(*b.second);
+      return Left != Right ? Left > Right : a.first < b.first;
+    });
+
+    printf("%-18s %14s %14s %16s\n", "Callsite", "Checks", "Failures",
+           "Failed samples");
+    for (auto const &[Callsite, Summary] : Sorted)
+      printf("0x%-16lx %14lu %14lu %9ld / %-5u\n", Callsite, Summary->Checks,
+             Summary->Failures, FailedSamples(*Summary), Samples);
+  }
+
+private:
+  unsigned Samples;
+  std::mutex Mutex;
+  uint64_t Records = 0;
+  uint64_t Unknown = 0;
+  std::map<uintptr_t, CallsiteSummary> Callsites;
+};
+
+struct ReplaySetup {
+  void *const *Entries;
+  uint32_t TraceScale;
+  size_t SlotSize;
+  ReplayResults &Results;
+};
+
+// Replays segments in order for one sample
+void ReplayStream(ReplaySetup const &Setup, std::vector<Segment> Segments,
+                  unsigned Sample) {
+  ReplayContext Context(Setup.Entries, Setup.TraceScale, Setup.SlotSize);
+  uint64_t Records = 0, Unknown = 0;
+  for (Segment const &Current : Segments) {
+    std::string Error;
+    TraceReader Reader(Current.Path, Error);
+    uint16_t Entry;
+    uintptr_t Callsite;
+    TracePayloadReader Payload;
+    while (Reader.Next(Entry, Callsite, Payload)) {
+      Records++;
+      if (Entry < ReplayEntryCount && ReplayEntries[Entry] != nullptr)
+        ReplayEntries[Entry](Context, Callsite, Payload);
+      else
+        Unknown++;
+    }
+  }
+  Setup.Results.Merge(Sample, Context, Records, Unknown);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  ReplayOptions Options = ParseOptions(argc, argv);
+  uint32_t TraceScale;
+  std::vector<ThreadTrace> Traces = GroupSegments(Options.Segments, TraceScale);
+
+  ReplayShadowScale = Options.ShadowScale;
+  SetPluginOptions();
+  void *const *Entries = LoadPlugin(Options.Backend);
+  reinterpret_cast<void (*)()>(Entries[0])(); // __interflop_init
+
+  // Long doubles have the largest shadows
+  size_t SlotSize = sizeof(long double) * ReplayShadowScale;
+  ReplayResults Results(Options.Samples);
+  ReplaySetup Setup = {Entries, TraceScale, SlotSize, Results};
+
+  // Samples first, so that the workers start with different threads of the
+  // trace
+  WorkStealingPool Pool(Options.Jobs);
+  for (unsigned Sample = 0; Sample < Options.Samples; Sample++)
+    for (ThreadTrace const &Thread : Traces) {
+      if (not Options.SplitSegments) {
+        Pool.Submit([&Setup, &Thread, Sample] {
+          ReplayStream(Setup, Thread.Segments, Sample);
+        });
+        continue;
+      }
+      for (Segment const &Current : Thread.Segments)
+        Pool.Submit([&Setup, &Current, Sample] {
+          ReplayStream(Setup, {Current}, Sample);
+        });
+    }
+
+  auto Start = std::chrono::steady_clock::now();
+  Pool.Run();
+  std::chrono::duration<double> Elapsed =
+      std::chrono::steady_clock::now() - Start;
+  Results.Print(Elapsed.count(), Traces.size(), Options.Backend.c_str());
+  return 0;
+}
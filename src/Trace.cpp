@@ -0,0 +1,161 @@
+/**
+ * @file Trace.cpp
+ * @brief Binary trace implementation
+ * @version 0.1.0
+ *
+ *
+ */
+
+#include "Trace.hpp"
+#include "Utils.hpp"
+#include <atomic>
+#include <cstdio>
+#include <fcntl.h>
+#include <memory>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace insane {
+
+namespace {
+
+// Copied from the flags, so that threads exiting after the context still trace
+struct TraceSettings {
+  char Prefix[4096];
+  size_t SegmentSize;
+  uint32_t Segments;
+  uint64_t InterfaceHash;
+};
+
+TraceSettings Settings;
+std::atomic<uint32_t> NextThread{0};
+
+// The prefix followed by ".<pid>.<thread>.<segment>.trace"
+constexpr size_t SegmentPathSize = sizeof(TraceSettings::Prefix) + 48;
+
+void SegmentPath(char *Path, uint32_t Thread, uint32_t Segment) {
+  snprintf(Path, SegmentPathSize, "%s.%d.%u.%u.trace", Settings.Prefix,
+           static_cast<int>(getpid()), Thread, Segment);
+}
+
+// Owns the current segment of a thread, closed when the thread exits
+struct TraceSegment {
+  TraceCursor Cursor = {nullptr, nullptr, 0, 0, 0, nullptr};
+  char *Data = nullptr;
+  int File = -1;
+  uint32_t Thread = 0;
+  uint32_t Segment = 0;
+  bool Started = false;
+  // Records are written there and dropped once a segment cannot be written
+  std::unique_ptr<char[]> Dropped;
+  std::unique_ptr<uint64_t[]> LastValues;
+
+  ~TraceSegment() { Close(); }
+
+  void Open() {
+    if (not Started) {
+      Thread = NextThread.fetch_add(1, std::memory_order_relaxed);
+      LastValues = std::make_unique<uint64_t[]>(TraceValueSlots);
+      Started = true;
+    }
+
+    char Path[SegmentPathSize];
+    // Rotation drops the oldest segment of the thread
+    if (Settings.Segments > 0 && Segment >= Settings.Segments) {
+      SegmentPath(Path, Thread, Segment - Settings.Segments);
+      unlink(Path);
+    }
+    SegmentPath(Path, Thread, Segment);
+    Segment++;
+
+    File = open(Path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    void *Mapping = MAP_FAILED;
+    if (File >= 0 && ftruncate(File, Settings.SegmentSize) == 0)
+      Mapping = mmap(nullptr, Settings.SegmentSize, PROT_READ | PROT_WRITE,
+                     MAP_SHARED, File, 0);
+    if (Mapping == MAP_FAILED) {
+      fprintf(stderr, "[INSanE] Cannot write the trace segment %s\n", Path);
+      Close();
+      Dropped = std::make_unique<char[]>(TraceMaxRecord);
+      Cursor = {Dropped.get(), Dropped.get() + TraceMaxRecord, 0, 0, 0,
+                LastValues.get()};
+      return;
+    }
+
+    Data = static_cast<char *>(Mapping);
+    TraceFileHeader Header = {};
+    std::memcpy(Header.Magic, TraceFileHeader::MagicValue, sizeof(Header.Magic));
+    Header.Version = TraceFileHeader::CurrentVersion;
+    Header.ShadowScale = TraceShadowScale;
+    Header.InterfaceHash = Settings.InterfaceHash;
+    Header.Process = static_cast<uint32_t>(getpid());
+    Header.Thread = Thread;
+    Header.Segment = Segment - 1;
+    std::memcpy(Data, &Header, sizeof(Header));
+    Cursor.Position = Data + sizeof(Header);
+    Cursor.End = Data + Settings.SegmentSize;
+    Cursor.LastValues = LastValues.get();
+    std::fill_n(Cursor.LastValues, TraceValueSlots, 0);
+  }
+
+  // Writes the final size of the segment and shrinks the file to it
+  void Close() {
+    if (Data != nullptr) {
+      auto *Header = reinterpret_cast<TraceFileHeader *>(Data);
+      Header->Size = Cursor.Position - Data - sizeof(TraceFileHeader);
+      Header->Records = Cursor.Records;
+      size_t Used = Cursor.Position - Data;
+      munmap(Data, Settings.SegmentSize);
+      if (ftruncate(File, Used) != 0)
+        fprintf(stderr, "[INSanE] Cannot truncate a trace segment\n");
+      Data = nullptr;
+    }
+    if (File >= 0)
+      close(File);
+    File = -1;
+    Cursor = {nullptr, nullptr, 0, 0, 0, nullptr};
+  }
+};
+
+thread_local TraceSegment LocalSegment;
+
+} // namespace
+
+void ConfigureTrace(RuntimeFlags const &Flags) {
+  if (not Flags.getTrace())
+    return;
+
+  snprintf(Settings.Prefix, sizeof(Settings.Prefix), "%s",
+           Flags.getTracePrefix().c_str());
+  // Large enough for a few records at least
+  Settings.SegmentSize =
+      std::max<size_t>(Flags.getTraceSegmentSize(), 1) << 20;
+  Settings.Segments = Flags.getTraceSegments();
+  Settings.InterfaceHash = &TraceInterfaceHash ? TraceInterfaceHash : 0;
+  TraceShadowScale = utils::GetNSanShadowScale();
+
+  if (Flags.getVerbose())
+    fprintf(stderr, "[INSanE] Tracing to %s.%d.*.trace\n", Settings.Prefix,
+            static_cast<int>(getpid()));
+  TraceEnabled = true;
+}
+
+void CloseThreadTrace() { LocalSegment.Close(); }
+
+TraceCursor &ReserveTraceRecord() {
+  TraceSegment &Segment = LocalSegment;
+  if (static_cast<size_t>(Segment.Cursor.End - Segment.Cursor.Position) <
+      TraceMaxRecord) {
+    if (Segment.Dropped)
+      Segment.Cursor = {Segment.Dropped.get(),
+                        Segment.Dropped.get() + TraceMaxRecord, 0, 0, 0,
+                        Segment.LastValues.get()};
+    else {
+      Segment.Close();
+      Segment.Open();
+    }
+  }
+  return Segment.Cursor;
+}
+
+} // namespace insane
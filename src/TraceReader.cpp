@@ -0,0 +1,77 @@
+/**
+ * @file TraceReader.cpp
+ * @brief Reads back the trace segments, without the rest of the core
+ * @version 0.1.0
+ *
+ *
+ */
+
+#include "Trace.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace insane {
+
+TraceReader::TraceReader(std::string const &Path, std::string &Error) {
+  int File = open(Path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (File < 0) {
+    Error = "cannot open " + Path;
+    return;
+  }
+  struct stat Status;
+  void *Mapping = MAP_FAILED;
+  if (fstat(File, &Status) == 0 &&
+      Status.st_size >= static_cast<off_t>(sizeof(TraceFileHeader)))
+    Mapping = mmap(nullptr, Status.st_size, PROT_READ, MAP_PRIVATE, File, 0);
+  close(File);
+  if (Mapping == MAP_FAILED) {
+    Error = "cannot map " + Path;
+    return;
+  }
+
+  Data = static_cast<char const *>(Mapping);
+  MappedSize = Status.st_size;
+  std::memcpy(&Header, Data, sizeof(Header));
+  if (std::memcmp(Header.Magic, TraceFileHeader::MagicValue,
+                  sizeof(Header.Magic)) != 0 ||
+      Header.Version != TraceFileHeader::CurrentVersion) {
+    Error = Path + " is not a trace segment of this version";
+    munmap(Mapping, MappedSize);
+    Data = nullptr;
+    return;
+  }
+
+  Position = Data + sizeof(Header);
+  End = Data + MappedSize;
+  // Segments still open end at the first zero entry
+  if (Header.Size != 0 && Header.Size <= MappedSize - sizeof(Header))
+    End = Position + Header.Size;
+}
+
+TraceReader::~TraceReader() {
+  if (Data != nullptr)
+    munmap(const_cast<char *>(Data), MappedSize);
+}
+
+bool TraceReader::Next(uint16_t &Entry, uintptr_t &Callsite,
+                       TracePayloadReader &Payload) {
+  TraceRecordHeader Record;
+  if (Data == nullptr ||
+      static_cast<size_t>(End - Position) < sizeof(TraceRecordHeader))
+    return false;
+  std::memcpy(&Record, Position, sizeof(Record));
+  if (Record.Entry == 0 ||
+      Record.Size > static_cast<size_t>(End - Position) - sizeof(Record))
+    return false;
+
+  Entry = Record.Entry - 1;
+  Payload =
+      TracePayloadReader(Position + sizeof(Record), LastShadow, LastValues);
+  Position += sizeof(Record) + Record.Size;
+  Callsite = Payload.Callsite(LastCallsite);
+  return true;
+}
+
+} // namespace insane
@@ -0,0 +1,204 @@
+/**
+ * @file WarningLog.cpp
+ * @brief Asynchronous warning emission implementation
+ * @version 0.1.0
+ *
+ *
+ */
+
+#include "WarningLog.hpp"
+#include "Context.hpp"
+#include "Region.hpp"
+#include <chrono>
+#include <sstream>
+#include <unistd.h>
+
+namespace insane {
+
+namespace {
+
+// Set once the log is destroyed, threads exiting later must not touch it
+std::atomic<bool> LogDestroyed{false};
+
+} // namespace
+
+// Owns the ring of a thread, the ring is allocated on the first warning to
+// keep it out of the static TLS block
+struct RingHandle {
+  WarningLog::Ring *Ring = nullptr;
+
+  ~RingHandle() {
+    if (Ring == nullptr)
+      return;
+    if (not LogDestroyed.load(std::memory_order_acquire))
+      WarningLog::getInstance().Unregister(*Ring);
+    delete Ring;
+  }
+};
+
+namespace {
+
+thread_local RingHandle LocalRingHandle;
+
+} // namespace
+
+void WarningLog::Ring::CopyIn(size_t Pos, void const *Src, size_t Size) {
+  size_t Offset = Pos & (Capacity - 1);
+  size_t First = std::min(Size, Capacity - Offset);
+  std::memcpy(Data + Offset, Src, First);
+  std::memcpy(Data, static_cast<char const *>(Src) + First, Size - First);
+}
+
+void WarningLog::Ring::CopyOut(size_t Pos, void *Dest, size_t Size) const {
+  size_t Offset = Pos & (Capacity - 1);
+  size_t First = std::min(Size, Capacity - Offset);
+  std::memcpy(Dest, Data + Offset, First);
+  std::memcpy(static_cast<char *>(Dest) + First, Data, Size - First);
+}
+
+WarningLog &WarningLog::getInstance() {
+  static WarningLog Log;
+  return Log;
+}
+
+WarningLog::~WarningLog() {
+  Stopping.store(true, std::memory_order_release);
+  WakeUp.notify_one();
+  if (Writer.joinable())
+    Writer.join();
+
+  Flush();
+  LogDestroyed.store(true, std::memory_order_release);
+}
+
+WarningLog::Ring &WarningLog::LocalRing() {
+  if (LocalRingHandle.Ring == nullptr) {
+    LocalRingHandle.Ring = new Ring;
+    std::scoped_lock<std::mutex> lock(RingsMutex);
+    LocalRingHandle.Ring->Next = Rings;
+    if (Rings)
+      Rings->Prev = LocalRingHandle.Ring;
+    Rings = LocalRingHandle.Ring;
+  }
+  return *LocalRingHandle.Ring;
+}
+
+// Emits the pending records of an exiting thread
+void WarningLog::Unregister(Ring &Source) {
+  std::scoped_lock<std::mutex> lock(RingsMutex);
+  Drain(Source);
+  WriteBatch();
+
+  if (Source.Prev)
+    Source.Prev->Next = Source.Next;
+  else
+    Rings = Source.Next;
+  if (Source.Next)
+    Source.Next->Prev = Source.Prev;
+}
+
+void WarningLog::Push(WarningFormatter Format, WarningPayload const &Payload) {
+  RecordHeader Header{Format, StacktraceRecorder::CurrentStackId(),
+                      static_cast<uint32_t>(Payload.size()), CurrentRegion()};
+
+  if (not InsaneContext::getInstance().Flags().getAsyncWarnings()) {
+    std::scoped_lock<std::mutex> lock(RingsMutex);
+    Emit(Header, Payload.data());
+    WriteBatch();
+    return;
+  }
+
+  std::call_once(WriterStarted,
+                 [this] { Writer = std::thread([this] { Run(); }); });
+
+  Ring &Local = LocalRing();
+  size_t Size = sizeof(RecordHeader) + Payload.size();
+  size_t Head = Local.Head.load(std::memory_order_relaxed);
+  // Wait for the writer to make room
+  while (Ring::Capacity - (Head - Local.Tail.load(std::memory_order_acquire)) <
+         Size) {
+    WakeUp.notify_one();
+    std::this_thread::yield();
+  }
+
+  Local.CopyIn(Head, &Header, sizeof(RecordHeader));
+  Local.CopyIn(Head + sizeof(RecordHeader), Payload.data(), Payload.size());
+  Local.Head.store(Head + Size, std::memory_order_release);
+  WakeUp.notify_one();
+}
+
+void WarningLog::Flush() {
+  std::scoped_lock<std::mutex> lock(RingsMutex);
+  for (Ring *It = Rings; It != nullptr; It = It->Next)
+    Drain(*It);
+  WriteBatch();
+}
+
+void WarningLog::Run() {
+  while (not Stopping.load(std::memory_order_acquire)) {
+    bool Drained = false;
+    {
+      std::scoped_lock<std::mutex> lock(RingsMutex);
+      for (Ring *It = Rings; It != nullptr; It = It->Next)
+        Drained |= Drain(*It);
+      WriteBatch();
+    }
+
+    // Producers notify without holding the lock, so a wakeup may be missed
+    if (not Drained) {
+      std::unique_lock<std::mutex> lock(WaitMutex);
+      WakeUp.wait_for(lock, std::chrono::milliseconds(10));
+    }
+  }
+}
+
+bool WarningLog::Drain(Ring &Source) {
+  size_t Tail = Source.Tail.load(std::memory_order_relaxed);
+  size_t Head = Source.Head.load(std::memory_order_acquire);
+  if (Tail == Head)
+    return false;
+
+  char Payload[WarningPayload::MaxSize];
+  while (Tail != Head) {
+    RecordHeader Header;
+    Source.CopyOut(Tail, &Header, sizeof(RecordHeader));
+    Source.CopyOut(Tail + sizeof(RecordHeader), Payload, Header.Size);
+    Tail += sizeof(RecordHeader) + Header.Size;
+    // The producer may reuse the space as soon as the record is copied
+    Source.Tail.store(Tail, std::memory_order_release);
+    Emit(Header, Payload);
+  }
+  return true;
+}
+
+void WarningLog::Emit(RecordHeader const &Header, char const *Payload) {
+  std::ostringstream Out;
+  WarningPayloadReader Reader(Payload);
+  Header.Format(Reader, Out);
+  if (Header.Region != 0)
+    Out << "\tIn region " << RegionName(Header.Region) << "\n";
+  Batch += Out.str();
+
+  // Stacktraces are printed once, repeated warnings are batched
+  if (PrintedStacks.insert(Header.StackId).second) {
+    // The stacktrace is printed by nsan, after what we formatted so far
+    WriteBatch();
+    utils::PrintStackTrace(Header.StackId);
+  } else
+    Batch += "\tSame stacktrace as a previous warning\n";
+  Batch += utils::AsciiColor::Reset.str();
+}
+
+void WarningLog::WriteBatch() {
+  size_t Written = 0;
+  while (Written < Batch.size()) {
+    ssize_t Res =
+        ::write(STDERR_FILENO, Batch.data() + Written, Batch.size() - Written);
+    if (Res <= 0)
+      break;
+    Written += Res;
+  }
+  Batch.clear();
+}
+
+} // namespace insane
@@ -0,0 +1,272 @@
+#include "Backend.hpp"
+#include "backends/DoublePrec.hpp"
+#include <cmath>
+#include <gtest/gtest.h>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+using namespace insane::doubleprec;
+
+// Shadows of the lanes of a value, and the pointers to them the backend takes
+template <size_t Size, typename ShadowType = DoublePrecShadow>
+struct ShadowLanes {
+  using OpaqueType =
+      std::conditional_t<std::is_same_v<ShadowType, DoublePrecLargeShadow>,
+                         insane::OpaqueLargeShadow, insane::OpaqueShadow>;
+
+  ShadowType Shadows[Size] = {};
+  ShadowType *Pointers[Size];
+
+  ShadowLanes() {
+    for (size_t I = 0; I < Size; I++)
+      Pointers[I] = &Shadows[I];
+  }
+
+  template <typename T> explicit ShadowLanes(T const &Values) : ShadowLanes() {
+    for (size_t I = 0; I < Size; I++) {
+      if constexpr (std::is_arithmetic_v<T>)
+        Shadows[I].val = Values;
+      else
+        Shadows[I].val = Values[I];
+    }
+  }
+
+  ShadowLanes(ShadowLanes const &other) = delete;
+  ShadowLanes &operator=(ShadowLanes const &other) = delete;
+
+  OpaqueType **opaque() { return reinterpret_cast<OpaqueType **>(Pointers); }
+  ShadowType &operator[](size_t I) { return Shadows[I]; }
+};
+
+// Contiguous shadows take the block kernels, scattered ones the lane kernels
+TEST(DoublePrec, VectorLanes) {
+  insane::v8float Left = {0.1f, 2, -3, 1e8f, 1, 2, 3, 1.f / 3};
+  insane::v8float Right = {0.2f, 0.5f, 3, 1, -1, 8, 0.25f, 3};
+  ShadowLanes<8> LeftShadows(Left), RightShadows(Right), ResShadows;
+  insane::InsaneRuntime<insane::MetaFloat<float, 8>> Backend;
+
+  for (bool Scattered : {false, true}) {
+    if (Scattered)
+      std::swap(ResShadows.Pointers[2], ResShadows.Pointers[5]);
+    auto Shadow = [&](int I) { return ResShadows.Pointers[I]->val; };
+
+    insane::v8float Sum = Backend.Add(Left, LeftShadows.opaque(), Right,
+                                      RightShadows.opaque(),
+                                      ResShadows.opaque());
+    for (int I = 0; I < 8; I++) {
+      EXPECT_EQ(Sum[I], Left[I] + Right[I]);
+      EXPECT_EQ(Shadow(I), double(Left[I]) + double(Right[I]));
+    }
+
+    Backend.Div(Left, LeftShadows.opaque(), Right, RightShadows.opaque(),
+                ResShadows.opaque());
+    for (int I = 0; I < 8; I++)
+      EXPECT_EQ(Shadow(I), double(Left[I]) / double(Right[I]));
+  }
+
+  // Double lanes are shadowed by large shadows
+  insane::v4double Wide = {0.1, 1e300, -3, 1. / 3};
+  ShadowLanes<4, DoublePrecLargeShadow> WideShadows(Wide), WideRes;
+  insane::InsaneRuntime<insane::MetaFloat<double, 4>> WideBackend;
+  WideBackend.Mul(Wide, WideShadows.opaque(), Wide, WideShadows.opaque(),
+                  WideRes.opaque());
+  for (int I = 0; I < 4; I++)
+    EXPECT_TRUE(WideRes[I].val ==
+                LargeShadowScalar(Wide[I]) * LargeShadowScalar(Wide[I]));
+}
+
+// Large shadows keep more than twice the digits of a double, with __float128
+// or double-double
+TEST(DoublePrec, LargeShadowPrecision) {
+  ShadowLanes<1, DoublePrecLargeShadow> One(1.0), Tiny(0x1p-80), Sum, Res;
+  insane::InsaneRuntime<insane::MetaFloat<double, 1>> Backend;
+
+  double Native =
+      Backend.Add(1.0, One.opaque(), 0x1p-80, Tiny.opaque(), Sum.opaque());
+  EXPECT_EQ(Native, 1.0);
+  Native = Backend.Sub(Native, Sum.opaque(), 1.0, One.opaque(), Res.opaque());
+  EXPECT_EQ(Native, 0.0);
+  EXPECT_TRUE(Res[0].val == LargeShadowScalar(0x1p-80));
+
+  // A third, times three, is one to about 2^-105
+  ShadowLanes<1, DoublePrecLargeShadow> Three(3.0), Third;
+  Native = Backend.Div(1.0, One.opaque(), 3.0, Three.opaque(), Third.opaque());
+  Backend.Mul(Native, Third.opaque(), 3.0, Three.opaque(), Res.opaque());
+  double Error = static_cast<double>(Res[0].val - LargeShadowScalar(1.0));
+  EXPECT_LT(std::abs(Error), 0x1p-100);
+}
+
+// (1 + 2^-k)^2 - (1 + 2^-(k-1)) == 2^-2k exactly, in float and in double
+TEST(DoublePrec, Fma) {
+  float Factor = 1 + 0x1p-12f, Addend = -(1 + 0x1p-11f);
+  ShadowLanes<1> Left(Factor), Addends(Addend), Res;
+  insane::InsaneRuntime<insane::MetaFloat<float, 1>> Backend;
+  EXPECT_EQ(Backend.Fma(Factor, Left.opaque(), Factor, Left.opaque(), Addend,
+                        Addends.opaque(), Res.opaque()),
+            0x1p-24f);
+  EXPECT_EQ(Res[0].val, 0x1p-24);
+
+  insane::v4float Factors = {Factor, 2, 0.1f, -3};
+  insane::v4float Addends4 = {Addend, 1, 0.2f, 0.5f};
+  ShadowLanes<4> FactorShadows(Factors), AddendShadows(Addends4), Lanes;
+  insane::InsaneRuntime<insane::MetaFloat<float, 4>> VectorBackend;
+  VectorBackend.Fma(Factors, FactorShadows.opaque(), Factors,
+                    FactorShadows.opaque(), Addends4, AddendShadows.opaque(),
+                    Lanes.opaque());
+  for (int I = 0; I < 4; I++)
+    EXPECT_EQ(Lanes[I].val, std::fma(double(Factors[I]), double(Factors[I]),
+                                     double(Addends4[I])));
+
+  double Wide = 1 + 0x1p-30, WideAddend = -(1 + 0x1p-29);
+  ShadowLanes<1, DoublePrecLargeShadow> WideLeft(Wide), WideAddends(WideAddend),
+      WideRes;
+  insane::InsaneRuntime<insane::MetaFloat<double, 1>> WideBackend;
+  EXPECT_EQ(WideBackend.Fma(Wide, WideLeft.opaque(), Wide, WideLeft.opaque(),
+                            WideAddend, WideAddends.opaque(),
+                            WideRes.opaque()),
+            0x1p-60);
+  EXPECT_TRUE(WideRes[0].val == LargeShadowScalar(0x1p-60));
+}
+
+TEST(DoublePrec, MathShadow) {
+  insane::v8float Operand = {0.5f, 1, 2, 3, 4, 5, 6, 0.1f};
+  ShadowLanes<8> Shadows(Operand), Res;
+  insane::InsaneRuntime<insane::MetaFloat<float, 8>> Backend;
+  // Float shadows are evaluated in double, vector libm variants may differ in
+  // the last bits
+  for (auto Opcode : {insane::Math_sqrt, insane::Math_exp, insane::Math_log,
+                      insane::Math_sin, insane::Math_cos}) {
+    Backend.Math(Opcode, Operand, Shadows.opaque(), Res.opaque());
+    for (int I = 0; I < 8; I++) {
+      double Expected = insane::ApplyMath<double>(Opcode, Operand[I]);
+      EXPECT_NEAR(Res[I].val, Expected, std::abs(Expected) * 0x1p-50)
+          << "Opcode " << Opcode << ", lane " << I;
+    }
+  }
+  Backend.Pow(Operand, Shadows.opaque(), Operand, Shadows.opaque(),
+              Res.opaque());
+  EXPECT_EQ(Res[2].val, 4);
+
+  // Large shadows are evaluated with the long double libm, 64 bits of mantissa
+  ShadowLanes<1, DoublePrecLargeShadow> Two(2.0), Root, Square;
+  insane::InsaneRuntime<insane::MetaFloat<double, 1>> WideBackend;
+  double Native =
+      WideBackend.Math(insane::Math_sqrt, 2.0, Two.opaque(), Root.opaque());
+  EXPECT_EQ(Native, std::sqrt(2.0));
+  WideBackend.Mul(Native, Root.opaque(), Native, Root.opaque(), Square.opaque());
+  double Error = static_cast<double>(Square[0].val - LargeShadowScalar(2.0));
+  EXPECT_LT(std::abs(Error), 0x1p-61);
+}
+
+TEST(DoublePrec, ReduceOrder) {
+  // A sequential sum absorbs the ones, in float and in double alike,
+  // pairwise by halves is (1e17 + -1e17) + (1 + 1)
+  insane::v4float Vec = {1e17f, 1, -1e17f, 1};
+  ShadowLanes<4> Lanes(Vec);
+  ShadowLanes<1> Start(0.5f), Res;
+  insane::InsaneRuntime<insane::MetaFloat<float, 4>> Backend;
+
+  // The shadows follow the order of the program
+  for (bool Reassoc : {false, true}) {
+    float Native = Backend.Reduce(insane::Reduce_fadd, Reassoc, 0.5f,
+                                  Start.opaque(), Vec, Lanes.opaque(),
+                                  Res.opaque());
+    double Sequential = 0.5;
+    for (int I = 0; I < 4; I++)
+      Sequential += double(Vec[I]);
+    EXPECT_EQ(Native, Reassoc ? 2.5f : 1.f);
+    EXPECT_EQ(Res[0].val, Reassoc ? 2.5 : Sequential);
+  }
+
+  float Native = Backend.Reduce(insane::Reduce_fmax, false, 0.5f,
+                                Start.opaque(), Vec, Lanes.opaque(),
+                                Res.opaque());
+  EXPECT_EQ(Native, 1e17f);
+  EXPECT_EQ(Res[0].val, double(1e17f));
+}
+
+TEST(DoublePrec, ShadowRange) {
+  insane::InsaneRuntime<insane::MetaFloat<float, 1>> Backend;
+  insane::InsaneRuntime<insane::MetaFloat<double, 1>> WideBackend;
+
+  // Large enough to be streamed, with an unaligned destination
+  for (size_t Count : {size_t(5), size_t(1) << 19}) {
+    std::vector<float> Values(Count);
+    std::vector<double> WideValues(Count);
+    for (size_t I = 0; I < Count; I++) {
+      Values[I] = 0.1f * I;
+      WideValues[I] = (I % 3 == 0) ? 0.1 * I : -1e300 / (I + 1);
+    }
+    std::vector<DoublePrecShadow> Shadows(Count + 1), Copies(Count);
+    Backend.MakeShadowRange(
+        Values.data(), reinterpret_cast<insane::OpaqueShadow *>(&Shadows[1]),
+        Count);
+    Backend.CopyShadowRange(
+        reinterpret_cast<insane::OpaqueShadow *>(Copies.data()),
+        reinterpret_cast<insane::OpaqueShadow *>(&Shadows[1]), Count);
+    for (size_t I = 0; I < Count; I++)
+      ASSERT_EQ(Copies[I].val, Values[I]);
+
+    std::vector<DoublePrecLargeShadow> WideShadows(Count);
+    WideBackend.MakeShadowRange(
+        WideValues.data(),
+        reinterpret_cast<insane::OpaqueLargeShadow *>(WideShadows.data()),
+        Count);
+    for (size_t I = 0; I < Count; I++)
+      ASSERT_TRUE(WideShadows[I].val == LargeShadowScalar(WideValues[I]));
+  }
+}
+
+TEST(DoublePrec, StridedBinary) {
+  insane::v8float Left = {1.5f, 2, -3, 0, 0.1f, 2, 3, 4};
+  insane::v8float Right = {2.25f, 0.5f, 3, 0, 0.3f, 8, 0.25f, 1024};
+  insane::InsaneRuntime<insane::MetaFloat<float, 8>> Backend;
+
+  // Contiguous shadows, then every other shadow
+  for (size_t Spacing : {1, 2}) {
+    std::vector<DoublePrecShadow> LeftShadows(8 * Spacing),
+        RightShadows(8 * Spacing), ResShadows(8 * Spacing);
+    for (int I = 0; I < 8; I++) {
+      LeftShadows[I * Spacing].val = Left[I];
+      RightShadows[I * Spacing].val = Right[I];
+    }
+    auto Span = [&](std::vector<DoublePrecShadow> &Shadows) {
+      return insane::ShadowSpan<insane::OpaqueShadow>{
+          reinterpret_cast<insane::OpaqueShadow *>(Shadows.data()),
+          Spacing * sizeof(DoublePrecShadow)};
+    };
+
+    insane::v8float Product =
+        Backend.Binary(insane::simd::FMul, Left, Span(LeftShadows), Right,
+                       Span(RightShadows), Span(ResShadows));
+    for (int I = 0; I < 8; I++) {
+      EXPECT_EQ(Product[I], Left[I] * Right[I]);
+      EXPECT_EQ(ResShadows[I * Spacing].val, double(Left[I]) * Right[I]);
+    }
+  }
+}
+
+// The shadow comparison is returned, so that the program branches on it
+TEST(DoublePrec, FCmpOpcodes) {
+  // 1e8 + 1 is 1e8 in float
+  ShadowLanes<1> Large(1e8f), Sum(1e8 + 1);
+  insane::InsaneRuntime<insane::MetaFloat<float, 1>> Backend;
+  EXPECT_FALSE((Backend.CheckFCmp<insane::FCmp_oeq, insane::Report_CountOnly>(
+      1e8f, Sum.opaque(), 1e8f, Large.opaque(), true)));
+  EXPECT_TRUE((Backend.CheckFCmp<insane::FCmp_ogt, insane::Report_CountOnly>(
+      1e8f, Sum.opaque(), 1e8f, Large.opaque(), false)));
+
+  // Vector comparisons hold if they hold on every lane, NaNs are unordered
+  float NaN = std::numeric_limits<float>::quiet_NaN();
+  insane::v4float Left = {0, 1, 2, NaN};
+  insane::v4float Right = {1, 2, 3, 4};
+  ShadowLanes<4> LeftShadows(Left), RightShadows(Right);
+  insane::InsaneRuntime<insane::MetaFloat<float, 4>> VectorBackend;
+  EXPECT_TRUE(VectorBackend.CheckFCmp(insane::FCmp_ult, Left,
+                                      LeftShadows.opaque(), Right,
+                                      RightShadows.opaque(), true));
+  EXPECT_FALSE(VectorBackend.CheckFCmp(insane::FCmp_olt, Left,
+                                       LeftShadows.opaque(), Right,
+                                       RightShadows.opaque(), false));
+}
@@ -0,0 +1,64 @@
+/**
+ * @file rounding_benchmark.cpp
+ * @brief Throughput of the stochastic rounding engines of float shadows
+ * @version 1.0
+ *
+ *
+ */
+
+#include "backends/MCASync.hpp"
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace insane::mcasync;
+
+constexpr size_t N_VALUES = 1 << 16;
+constexpr size_t N_RUNS = 200;
+
+template <typename Func> double MeasureNs(Func &&F) {
+  auto Start = std::chrono::steady_clock::now();
+  F();
+  auto End = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(End - Start).count() /
+         (N_VALUES * N_RUNS);
+}
+
+int main() {
+  std::mt19937 Gen(42);
+  std::uniform_real_distribution<double> Dist(-1e3, 1e3);
+
+  // Float products, exact in double, and their float rounding error
+  std::vector<double> Exact(N_VALUES);
+  std::vector<float> Values(N_VALUES), Errors(N_VALUES);
+  for (size_t I = 0; I < N_VALUES; I++) {
+    float a = Dist(Gen), b = Dist(Gen);
+    Exact[I] = static_cast<double>(a) * b;
+    Values[I] = a * b;
+    Errors[I] = std::fma(a, b, -Values[I]);
+  }
+
+  volatile float Sink = 0;
+
+  double Widened = MeasureNs([&] {
+    float Acc = 0;
+    for (size_t Run = 0; Run < N_RUNS; Run++)
+      for (size_t I = 0; I < N_VALUES; I++)
+        Acc += StochasticRound(Exact[I]);
+    Sink = Acc;
+  });
+
+  double EFT = MeasureNs([&] {
+    float Acc = 0;
+    for (size_t Run = 0; Run < N_RUNS; Run++)
+      for (size_t I = 0; I < N_VALUES; I++)
+        Acc += StochasticRound(Values[I], Errors[I]);
+    Sink = Acc;
+  });
+
+  std::cout << "StochasticRound(double)       : " << Widened << " ns/value\n";
+  std::cout << "StochasticRound(float, float) : " << EFT << " ns/value\n";
+  return 0;
+}
@@ -0,0 +1,131 @@
+#include "Backend.hpp"
+#include "Context.hpp"
+#include "Flags.hpp"
+#include "Region.hpp"
+#include "backends/MCASync.hpp"
+#include <condition_variable>
+#include <cstdlib>
+#include <gtest/gtest.h>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+using namespace insane::mcasync;
+
+class Regions : public testing::Test {
+protected:
+  // Samples spread enough for their checks to fail
+  MCASyncShadow Shadow = {{1, 1.001f, 1}, {0}};
+  MCASyncShadow *ShadowPtr = &Shadow;
+  insane::OpaqueShadow **Opaque =
+      reinterpret_cast<insane::OpaqueShadow **>(&ShadowPtr);
+  insane::InsaneRuntime<insane::MetaFloat<float, 1>> Backend;
+
+  bool Check() { return Backend.Check<insane::Report_CountOnly>(1.0f, Opaque); }
+
+  static std::string Stats() {
+    std::ostringstream Out;
+    insane::PrintRegionStats(Out);
+    return Out.str();
+  }
+
+  // Leaving a region updates the state of the thread from the flags
+  void TearDown() override {
+    insane::InsaneContext::getInstance().Flags().setRegionsOnly(false);
+    __insane_begin_region("");
+    __insane_end_region();
+  }
+};
+
+TEST_F(Regions, RegionsOnly) {
+  // The state of the thread is updated when it leaves a region
+  insane::InsaneContext::getInstance().Flags().setRegionsOnly(true);
+  __insane_begin_region("kernel");
+  __insane_end_region();
+
+  // Outside of the regions, nothing is checked and rounding is deterministic
+  EXPECT_FALSE(Check());
+  for (int I = 0; I < 100; I++)
+    ASSERT_EQ(StochasticRound(0.1), 0.1f);
+
+  __insane_begin_region("kernel");
+  EXPECT_TRUE(Check());
+  __insane_set_checking(false);
+  EXPECT_FALSE(Check());
+  __insane_set_checking(true);
+  __insane_end_region();
+  EXPECT_EQ(insane::CurrentRegion(), 0u);
+
+  EXPECT_NE(Stats().find("kernel: 2 entries, 1 checks, 1 failed"),
+            std::string::npos);
+}
+
+TEST_F(Regions, RoundingStats) {
+  __insane_begin_region("rounding");
+  for (int I = 0; I < 10; I++)
+    StochasticRound(0.1);
+  for (int I = 0; I < 5; I++)
+    StochasticRound(0.5);
+  __insane_end_region();
+
+  EXPECT_NE(Stats().find("rounding: 1 entries, 0 checks, 0 failed, "
+                         "15 roundings (5 exact)"),
+            std::string::npos);
+}
+
+TEST_F(Regions, ExitedThread) {
+  // The thread exits without leaving its region
+  std::thread([this] {
+    __insane_begin_region("exited");
+    Check();
+    Check();
+  }).join();
+
+  EXPECT_NE(Stats().find("exited: 1 entries, 2 checks, 2 failed"),
+            std::string::npos);
+}
+
+TEST_F(Regions, RunningThread) {
+  std::mutex Mutex;
+  std::condition_variable Changed;
+  bool Checked = false, Done = false;
+
+  std::thread Thread([&] {
+    __insane_begin_region("running");
+    Check();
+    std::unique_lock<std::mutex> lock(Mutex);
+    Checked = true;
+    Changed.notify_all();
+    Changed.wait(lock, [&] { return Done; });
+  });
+
+  {
+    std::unique_lock<std::mutex> lock(Mutex);
+    Changed.wait(lock, [&] { return Checked; });
+  }
+  EXPECT_NE(Stats().find("running: 1 entries, 1 checks, 1 failed"),
+            std::string::npos);
+
+  {
+    std::scoped_lock<std::mutex> lock(Mutex);
+    Done = true;
+  }
+  Changed.notify_all();
+  Thread.join();
+  EXPECT_NE(Stats().find("running: 1 entries, 1 checks, 1 failed"),
+            std::string::npos);
+}
+
+// Initializes the context, kept last
+TEST_F(Regions, CheckBeforeInit) {
+  std::thread([this] {
+    // Checked with the default flags
+    EXPECT_TRUE(Check());
+
+    setenv("INSANE_OPTIONS", "regions_only=true", 1);
+    insane::InsaneContext::getInstance().Init();
+    unsetenv("INSANE_OPTIONS");
+    EXPECT_FALSE(Check());
+  }).join();
+}
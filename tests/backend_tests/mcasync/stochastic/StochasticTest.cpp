@@ -1,17 +1,34 @@
+#include "Backend.hpp"
+#include "Context.hpp"
+#include "Flags.hpp"
+#include "Simd.hpp"
 #include "backends/MCASync.hpp"
+#include <cmath>
+#include <condition_variable>
 #include <filesystem>
 #include <fstream>
 #include <gtest/gtest.h>
 #include <iomanip>
 #include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
 
 
 using namespace insane::mcasync;
 
 constexpr size_t N_SAMPLE = 100000;
 
+// Rounds with error-free transformations instead of widening to double
+float EFTRound(double x) {
+  float Value = x;
+  return StochasticRound(Value, static_cast<float>(x - Value));
+}
+
 // Helper methods to generate samples from a given input
-void Sample(double Input, std::pair<size_t, size_t> &Counts) {
+void Sample(double Input, std::pair<size_t, size_t> &Counts,
+            float (*Round)(double) = StochasticRound) {
 
   // We know the bounds of the output value
   float roundup, rounddown, f32_round = Input;
@@ -26,7 +43,7 @@ void Sample(double Input, std::pair<size_t, size_t> &Counts) {
 
   Counts = {0, 0};
   for (int I = 0; I < N_SAMPLE; ++I) {
-    float x = StochasticRound(Input);
+    float x = Round(Input);
     if (x == rounddown)
       Counts.first++;
     else if (x == roundup)
@@ -57,9 +74,9 @@ double ChanceRoundup(double x) {
   return (x - xround_down) / (xround_up - xround_down);
 }
 
-void CalcSampleRatio(double X) {
+void CalcSampleRatio(double X, float (*Round)(double) = StochasticRound) {
   std::pair<size_t, size_t> Counts = {0, 0};
-  Sample(X, Counts);
+  Sample(X, Counts, Round);
 
   // We check the rounding ratio is coherent with the expected outputs
   // probabilites
@@ -71,6 +88,73 @@ void CalcSampleRatio(double X) {
   EXPECT_NEAR((double)Counts.second / N_SAMPLE, p, 2e-2);
 }
 
+// Same as CalcSampleRatio, but rounds the three samples of a shadow at once
+void CalcVectorSampleRatio(double X) {
+  float Rounded = X;
+  float Other = Rounded <= X
+                    ? std::nextafter(Rounded, std::numeric_limits<float>::max())
+                    : std::nextafter(Rounded, std::numeric_limits<float>::lowest());
+  float RoundDown = std::min(Rounded, Other);
+  float RoundUp = std::max(Rounded, Other);
+
+  std::array<size_t, 3> Ups = {0, 0, 0};
+  for (int I = 0; I < N_SAMPLE; ++I) {
+    insane::v4float Res = StochasticRound(insane::v4double{X, X, X, X});
+    // The padding lane is always cleared
+    ASSERT_EQ(Res[3], 0.0f);
+    for (int J = 0; J < 3; J++) {
+      ASSERT_TRUE(Res[J] == RoundDown || Res[J] == RoundUp);
+      Ups[J] += Res[J] == RoundUp && RoundUp != RoundDown;
+    }
+  }
+
+  const double p = ChanceRoundup(X);
+  for (size_t Up : Ups)
+    EXPECT_NEAR((double)Up / N_SAMPLE, p, 2e-2);
+}
+
+// Shadows of the lanes of a value, every sample holding the lane, and the
+// pointers to them the backend takes
+template <size_t Size, typename ShadowType = MCASyncShadow> struct ShadowLanes {
+  using SampleType = std::remove_extent_t<decltype(ShadowType::val)>;
+  using OpaqueType =
+      std::conditional_t<std::is_same_v<ShadowType, MCASyncLargeShadow>,
+                         insane::OpaqueLargeShadow, insane::OpaqueShadow>;
+
+  ShadowType Shadows[Size] = {};
+  ShadowType *Pointers[Size];
+
+  ShadowLanes() {
+    for (size_t I = 0; I < Size; I++)
+      Pointers[I] = &Shadows[I];
+  }
+
+  template <typename T> explicit ShadowLanes(T const &Values) : ShadowLanes() {
+    for (size_t I = 0; I < Size; I++) {
+      SampleType Value;
+      if constexpr (std::is_arithmetic_v<T>)
+        Value = Values;
+      else
+        Value = Values[I];
+      Shadows[I] = {{Value, Value, Value}, {0}};
+    }
+  }
+
+  ShadowLanes(ShadowLanes const &other) = delete;
+  ShadowLanes &operator=(ShadowLanes const &other) = delete;
+
+  OpaqueType **opaque() { return reinterpret_cast<OpaqueType **>(Pointers); }
+  ShadowType &operator[](size_t I) { return Shadows[I]; }
+};
+
+// Restores the kernel variants selected at startup
+class MCASyncKernels : public testing::Test {
+protected:
+  insane::simd::ISA Selected = insane::simd::GetISA();
+
+  void TearDown() override { insane::simd::SelectISA(Selected); }
+};
+
 TEST(MCASync, RoundInfinite) {
   constexpr double Infinite = std::numeric_limits<double>::infinity();
   float X = StochasticRound(Infinite);
@@ -93,6 +177,41 @@ TEST(MCASync, RoundRandomFloat) {
     CalcSampleRatio(X);
 }
 
+TEST(MCASync, EFTRoundRandomFloat) {
+
+  std::array<double, 8> Randoms = {2.13,  4.48,  68.15,   404.33,
+                                   580.9, 605.7, 1200.36, 1234.5};
+
+  for (double X : Randoms)
+    CalcSampleRatio(X, EFTRound);
+}
+
+TEST(MCASync, EFTRoundSpecialValues) {
+  constexpr float Infinite = std::numeric_limits<float>::infinity();
+  EXPECT_TRUE(std::isinf(StochasticRound(Infinite, 0.0f)));
+  EXPECT_TRUE(std::isnan(StochasticRound(NAN, 0.0f)));
+  // Exact results are never perturbed
+  for (int I = 0; I < 100; I++)
+    EXPECT_EQ(StochasticRound(1.5f, 0.0f), 1.5f);
+  // Underflowing results round to zero or the smallest subnormal
+  float Smallest = std::numeric_limits<float>::denorm_min();
+  for (int I = 0; I < 100; I++) {
+    float Res = StochasticRound(0.0f, Smallest / 4);
+    EXPECT_TRUE(Res == 0.0f || Res == Smallest);
+  }
+}
+
+TEST(MCASync, VectorRoundRandomFloat) {
+
+  std::array<double, 8> Randoms = {2.13,  4.48,  68.15,   404.33,
+                                   580.9, 605.7, 1200.36, -1234.5};
+
+  for (double X : Randoms)
+    CalcVectorSampleRatio(X);
+  // Exercise the scalar fallback
+  CalcVectorSampleRatio(1e-40);
+}
+
 TEST(MCASync, RoundPowerOfTwo) {
   std::array<double, 8> Powers = {2, 4, 8, 16, 32, 64, 12, 256};
 
@@ -108,6 +227,80 @@ TEST(MCASync, RoundPowerOfTwo) {
     CalcSampleRatio(-(1 / X));
 }
 
+TEST(MCASync, RoundExactFastPath) {
+  std::array<double, 6> Exacts = {0, 3, -1024, 0.375, 1e-40f, 16777216};
+
+  RoundingStats Before = GetRoundingStats();
+  for (double X : Exacts) {
+    EXPECT_EQ(StochasticRound(X), static_cast<float>(X));
+    insane::v4double Samples = {X, X, X, 0};
+    EXPECT_EQ(StochasticRound(Samples)[0], static_cast<float>(X));
+  }
+  RoundingStats After = GetRoundingStats();
+  EXPECT_EQ(After.Exact - Before.Exact, 4 * Exacts.size());
+  EXPECT_EQ(After.Total - Before.Total, 4 * Exacts.size());
+
+  // Inexact results are counted but never take the fast path
+  StochasticRound(0.1);
+  EXPECT_EQ(GetRoundingStats().Exact, After.Exact);
+  EXPECT_EQ(GetRoundingStats().Total, After.Total + 1);
+}
+
+// Counts of running threads are included, and kept once they exit
+TEST(MCASync, RoundingStatsThreads) {
+  RoundingStats Before = GetRoundingStats();
+  std::mutex Mutex;
+  std::condition_variable Changed;
+  bool Counted = false, Checked = false;
+  std::thread Thread([&] {
+    StochasticRound(3.0);
+    StochasticRound(0.1);
+    std::unique_lock<std::mutex> lock(Mutex);
+    Counted = true;
+    Changed.notify_all();
+    Changed.wait(lock, [&] { return Checked; });
+  });
+  {
+    std::unique_lock<std::mutex> lock(Mutex);
+    Changed.wait(lock, [&] { return Counted; });
+    RoundingStats Running = GetRoundingStats();
+    EXPECT_EQ(Running.Exact - Before.Exact, 1u);
+    EXPECT_EQ(Running.Total - Before.Total, 2u);
+    Checked = true;
+    Changed.notify_all();
+  }
+  Thread.join();
+  RoundingStats Exited = GetRoundingStats();
+  EXPECT_EQ(Exited.Exact - Before.Exact, 1u);
+  EXPECT_EQ(Exited.Total - Before.Total, 2u);
+}
+
+TEST(MCASync, RoundDoubleDouble) {
+  // Pairs of (value, fraction of an ulp to add to it)
+  std::array<std::pair<double, double>, 6> Inputs = {
+      {{1.0, 0.3}, {1.0, -0.3}, {-3.14, 0.45}, {1e300, 0.1}, {1e-300, -0.2},
+       {4.48, 0.0}}};
+
+  for (auto [Value, Fraction] : Inputs) {
+    double Up = std::nextafter(Value, Fraction < 0
+                                          ? -std::numeric_limits<double>::max()
+                                          : std::numeric_limits<double>::max());
+    insane::DoubleDouble X =
+        insane::DoubleDouble::sum(Value, (Up - Value) * std::abs(Fraction));
+
+    size_t Count = 0;
+    for (int I = 0; I < N_SAMPLE; ++I) {
+      double Res = StochasticRound(X);
+      ASSERT_TRUE(Res == Value || Res == Up);
+      Count += (Res == Up && Up != Value);
+    }
+    EXPECT_NEAR((double)Count / N_SAMPLE, std::abs(Fraction), 2e-2);
+  }
+
+  EXPECT_TRUE(std::isinf(StochasticRound(insane::DoubleDouble::sum(
+      std::numeric_limits<double>::max(), std::numeric_limits<double>::max()))));
+}
+
 #if FLT_HAS_SUBNORM
 
 TEST(MCASync, RoundExactSubnormal) {
@@ -138,4 +331,313 @@ TEST(MCASync, RoundInexactSubnormal) {
     CalcSampleRatio(InexactValueTests[I]);
 }
 
-#endif
\ No newline at end of file
+#endif
+TEST(MCASync, FmaSingleRounding) {
+  // (1 + 2^-12)^2 - (1 + 2^-11) == 2^-24 exactly, while rounding the product
+  // first gives either 0 or 2^-23
+  float Factor = 1 + 0x1p-12f, Addend = -(1 + 0x1p-11f);
+  ShadowLanes<1> Left(Factor), Addends(Addend), Res;
+
+  insane::InsaneRuntime<insane::MetaFloat<float, 1>> Backend;
+  for (int I = 0; I < 100; ++I) {
+    Backend.Fma(Factor, Left.opaque(), Factor, Left.opaque(), Addend,
+                Addends.opaque(), Res.opaque());
+    for (int Sample = 0; Sample < 3; Sample++)
+      ASSERT_EQ(Res[0].val[Sample], 0x1p-24f);
+  }
+
+  // 1 +- 2^-60 is not a double, rounding the sum to double first would give
+  // 1, a float, which is never perturbed
+  float Small = 0x1p-30f, One = 1;
+  for (float Sign : {1.f, -1.f}) {
+    float Right = Sign * Small;
+    ShadowLanes<1> SmallShadow(Small), RightShadow(Right), OneShadow(One);
+    RoundingStats Before = GetRoundingStats();
+    Backend.Fma(Small, SmallShadow.opaque(), Right, RightShadow.opaque(), One,
+                OneShadow.opaque(), Res.opaque());
+    RoundingStats After = GetRoundingStats();
+    EXPECT_EQ(After.Exact, Before.Exact);
+    EXPECT_EQ(After.Total, Before.Total + 3);
+    // The neighbours of the exact result
+    for (int Sample = 0; Sample < 3; Sample++)
+      EXPECT_TRUE(Res[0].val[Sample] == 1 ||
+                  Res[0].val[Sample] ==
+                      (Sign > 0 ? 1 + 0x1p-23f : 1 - 0x1p-24f));
+  }
+}
+
+TEST(MCASync, MathShadow) {
+  ShadowLanes<1> Operand(4.0f), Res;
+
+  insane::InsaneRuntime<insane::MetaFloat<float, 1>> Backend;
+  // Exact results are never perturbed
+  EXPECT_EQ(
+      Backend.Math(insane::Math_sqrt, 4, Operand.opaque(), Res.opaque()), 2);
+  for (int Sample = 0; Sample < 3; Sample++)
+    EXPECT_EQ(Res[0].val[Sample], 2);
+
+  // Inexact results are rounded to one of the floats around exp(4)
+  float Down = std::exp(4.0), Up = Down;
+  if (Down < std::exp(4.0))
+    Up = std::nextafter(Down, std::numeric_limits<float>::max());
+  else
+    Down = std::nextafter(Up, 0.0f);
+  for (int I = 0; I < 100; ++I) {
+    Backend.Math(insane::Math_exp, 4, Operand.opaque(), Res.opaque());
+    for (int Sample = 0; Sample < 3; Sample++)
+      ASSERT_TRUE(Res[0].val[Sample] == Down || Res[0].val[Sample] == Up);
+  }
+}
+
+TEST(MCASync, ReduceOrder) {
+  // A sequential sum absorbs the ones, pairwise by halves is
+  // (1e8 + -1e8) + (1 + 1)
+  insane::v4float Vec = {1e8f, 1, -1e8f, 1};
+  ShadowLanes<4> Lanes(Vec);
+  ShadowLanes<1> Start(0.5f), Res;
+
+  insane::InsaneRuntime<insane::MetaFloat<float, 4>> Backend;
+  // The samples follow the order of the program, and lose the ones too,
+  // 0.5 + 1e8 is rounded to a multiple of 8 either way
+  for (bool Reassoc : {false, true}) {
+    float Native = Backend.Reduce(insane::Reduce_fadd, Reassoc, 0.5f,
+                                  Start.opaque(), Vec, Lanes.opaque(),
+                                  Res.opaque());
+    EXPECT_EQ(Native, Reassoc ? 2.5f : 1.f);
+    for (int Sample = 0; Sample < 3; Sample++) {
+      if (Reassoc) {
+        EXPECT_EQ(Res[0].val[Sample], 2.5f);
+      } else {
+        EXPECT_EQ(std::fmod(Res[0].val[Sample], 8.f), 1.f);
+      }
+    }
+  }
+
+  float Native = Backend.Reduce(insane::Reduce_fmin, false, 0.5f,
+                                Start.opaque(), Vec, Lanes.opaque(),
+                                Res.opaque());
+  EXPECT_EQ(Native, -1e8f);
+  EXPECT_EQ(Res[0].val[0], -1e8f);
+}
+
+TEST(MCASync, ShadowRange) {
+  insane::InsaneRuntime<insane::MetaFloat<float, 1>> Backend;
+
+  // Large enough to be streamed, with an unaligned destination
+  for (size_t Count : {size_t(5), size_t(1) << 19}) {
+    std::vector<float> Values(Count);
+    for (size_t I = 0; I < Count; I++)
+      Values[I] = 0.5f * I;
+    std::vector<MCASyncShadow> Shadows(Count + 1), Copies(Count);
+    Backend.MakeShadowRange(
+        Values.data(), reinterpret_cast<insane::OpaqueShadow *>(&Shadows[1]),
+        Count);
+    Backend.CopyShadowRange(
+        reinterpret_cast<insane::OpaqueShadow *>(Copies.data()),
+        reinterpret_cast<insane::OpaqueShadow *>(&Shadows[1]), Count);
+
+    for (size_t I = 0; I < Count; I++)
+      for (int Sample = 0; Sample < 3; Sample++)
+        ASSERT_EQ(Copies[I].val[Sample], Values[I]);
+  }
+}
+
+TEST_F(MCASyncKernels, KernelVariantsAgree) {
+  using insane::simd::ISA;
+  insane::v8float Left = {1.5f, 2, -3, 0, 1, 2, 3, 4};
+  insane::v8float Right = {2.25f, 0.5f, 3, 0, -1, 8, 0.25f, 1024};
+  ShadowLanes<8> LeftShadows(Left), RightShadows(Right), ResShadows;
+
+  insane::InsaneRuntime<insane::MetaFloat<float, 8>> Backend;
+  for (ISA Max : {ISA::Generic, ISA::SSE42, ISA::AVX2, ISA::AVX512}) {
+    insane::simd::SelectISA(Max);
+
+    // Exact sums are never perturbed
+    insane::v8float Sum = Backend.Add(Left, LeftShadows.opaque(), Right,
+                                      RightShadows.opaque(),
+                                      ResShadows.opaque());
+    for (int I = 0; I < 8; I++)
+      for (int Sample = 0; Sample < 3; Sample++)
+        ASSERT_EQ(ResShadows[I].val[Sample], Sum[I]);
+    EXPECT_FALSE(Backend.Check(Sum, ResShadows.opaque()));
+
+    // A single lane without enough significant digits fails the check
+    ResShadows[5].val[1] *= 1.001f;
+    EXPECT_TRUE(Backend.Check(Sum, ResShadows.opaque()));
+  }
+}
+
+TEST_F(MCASyncKernels, MathVariantsAgree) {
+  using insane::simd::ISA;
+  insane::v8float Left = {0.5f, 1, 2, 3, 4, 5, 6, 7};
+  insane::v8float Right = {2, 0.5f, 3, -1, 0.25f, 2, 1, 1.5f};
+  ShadowLanes<8> LeftShadows(Left), RightShadows(Right), ResShadows;
+
+  insane::InsaneRuntime<insane::MetaFloat<float, 8>> Backend;
+  for (ISA Max : {ISA::Generic, ISA::SSE42, ISA::AVX2, ISA::AVX512}) {
+    insane::simd::SelectISA(Max);
+    for (auto Opcode : {insane::Math_sqrt, insane::Math_exp, insane::Math_log,
+                        insane::Math_sin, insane::Math_cos}) {
+      Backend.Math(Opcode, Left, LeftShadows.opaque(), ResShadows.opaque());
+      // Every sample is one of the floats around the double result
+      for (int I = 0; I < 8; I++) {
+        double Exact = insane::ApplyMath<double>(Opcode, Left[I]);
+        float Down = Exact, Up = Down;
+        if (Down < Exact)
+          Up = std::nextafter(Down, std::numeric_limits<float>::max());
+        else if (Down > Exact)
+          Down = std::nextafter(Up, std::numeric_limits<float>::lowest());
+        for (int Sample = 0; Sample < 3; Sample++)
+          ASSERT_TRUE(ResShadows[I].val[Sample] == Down ||
+                      ResShadows[I].val[Sample] == Up)
+              << "Opcode " << Opcode << ", lane " << I;
+      }
+    }
+
+    Backend.Pow(Left, LeftShadows.opaque(), Right, RightShadows.opaque(),
+                ResShadows.opaque());
+    // Exact powers are never perturbed
+    for (int Sample = 0; Sample < 3; Sample++) {
+      EXPECT_EQ(ResShadows[0].val[Sample], 0.25f);
+      EXPECT_EQ(ResShadows[2].val[Sample], 8);
+    }
+  }
+}
+
+TEST_F(MCASyncKernels, LargeKernelVariantsAgree) {
+  using insane::simd::ISA;
+  insane::v4double Left = {1, 0.1, 1e300, 3};
+  insane::v4double Right = {2, 0.2, 1e300, 0};
+  ShadowLanes<4, MCASyncLargeShadow> LeftShadows(Left), RightShadows(Right),
+      ResShadows;
+  auto *OpaqueLeft = LeftShadows.opaque();
+  auto *OpaqueRight = RightShadows.opaque();
+  auto *OpaqueRes = ResShadows.opaque();
+
+  // Every sample is the rounded to nearest result or its neighbour towards
+  // the exact one
+  auto ExpectRounded = [&](insane::DoubleDouble Exact, int Lane) {
+    double Neighbour = std::nextafter(
+        Exact.hi, Exact.lo > 0 ? std::numeric_limits<double>::infinity()
+                               : -std::numeric_limits<double>::infinity());
+    for (int Sample = 0; Sample < 3; Sample++)
+      EXPECT_TRUE(ResShadows[Lane].val[Sample] == Exact.hi ||
+                  (Exact.lo != 0 && ResShadows[Lane].val[Sample] == Neighbour))
+          << "lane " << Lane;
+    EXPECT_EQ(ResShadows[Lane].padding[0], 0u);
+  };
+
+  insane::InsaneRuntime<insane::MetaFloat<double, 4>> Backend;
+  for (ISA Max : {ISA::Generic, ISA::SSE42, ISA::AVX2, ISA::AVX512}) {
+    insane::simd::SelectISA(Max);
+
+    RoundingStats Before = GetRoundingStats();
+    Backend.Add(Left, OpaqueLeft, Right, OpaqueRight, OpaqueRes);
+    RoundingStats After = GetRoundingStats();
+    // Only 0.1 + 0.2 is inexact, and the paddings are not counted
+    EXPECT_EQ(After.Exact, Before.Exact + 9);
+    EXPECT_EQ(After.Total, Before.Total + 12);
+    for (int I = 0; I < 4; I++)
+      ExpectRounded(insane::DoubleDouble::sum(Left[I], Right[I]), I);
+
+    // Infinites are kept
+    Backend.Mul(Left, OpaqueLeft, Right, OpaqueRight, OpaqueRes);
+    for (int I = 0; I < 4; I++)
+      ExpectRounded(insane::DoubleDouble::product(Left[I], Right[I]), I);
+    EXPECT_EQ(ResShadows[2].val[0], std::numeric_limits<double>::infinity());
+
+    Backend.Div(Left, OpaqueLeft, Right, OpaqueRight, OpaqueRes);
+    for (int I = 0; I < 3; I++)
+      ExpectRounded(insane::DoubleDouble::quotient(Left[I], Right[I]), I);
+    EXPECT_EQ(ResShadows[3].val[1], std::numeric_limits<double>::infinity());
+
+    Backend.Fma(Left, OpaqueLeft, Right, OpaqueRight, Left, OpaqueLeft,
+                OpaqueRes);
+    for (int I = 0; I < 4; I++)
+      ExpectRounded(insane::DoubleDouble::product(Left[I], Right[I]) +
+                        insane::DoubleDouble(Left[I]),
+                    I);
+    EXPECT_EQ(ResShadows[2].val[2], std::numeric_limits<double>::infinity());
+  }
+}
+
+TEST(MCASync, StridedBinary) {
+  insane::v8float Left = {1.5f, 2, -3, 0, 1, 2, 3, 4};
+  insane::v8float Right = {2.25f, 0.5f, 3, 0, -1, 8, 0.25f, 1024};
+  insane::InsaneRuntime<insane::MetaFloat<float, 8>> Backend;
+
+  // Contiguous shadows, then every other shadow
+  for (size_t Spacing : {1, 2}) {
+    std::vector<MCASyncShadow> LeftShadows(8 * Spacing),
+        RightShadows(8 * Spacing), ResShadows(8 * Spacing);
+    for (int I = 0; I < 8; I++) {
+      LeftShadows[I * Spacing] = {{Left[I], Left[I], Left[I]}, {0}};
+      RightShadows[I * Spacing] = {{Right[I], Right[I], Right[I]}, {0}};
+      ResShadows[I * Spacing].padding[0] = 42;
+    }
+    auto Span = [&](std::vector<MCASyncShadow> &Shadows) {
+      return insane::ShadowSpan<insane::OpaqueShadow>{
+          reinterpret_cast<insane::OpaqueShadow *>(Shadows.data()),
+          Spacing * sizeof(MCASyncShadow)};
+    };
+
+    insane::v8float Product = Backend.Binary(
+        insane::simd::FMul, Left, Span(LeftShadows), Right,
+        Span(RightShadows), Span(ResShadows));
+    for (int I = 0; I < 8; I++) {
+      EXPECT_EQ(Product[I], Left[I] * Right[I]);
+      for (int Sample = 0; Sample < 3; Sample++)
+        EXPECT_EQ(ResShadows[I * Spacing].val[Sample], Product[I]);
+    }
+    if (Spacing == 1) {
+      EXPECT_EQ(ResShadows[5].padding[0], 0u);
+    }
+  }
+}
+
+TEST(MCASync, FCmpOpcodes) {
+  using insane::ReduceFCmp;
+  float NaN = std::numeric_limits<float>::quiet_NaN();
+  EXPECT_TRUE(ReduceFCmp<insane::FCmp_ult>(NaN, 1.0f));
+  EXPECT_FALSE(ReduceFCmp<insane::FCmp_olt>(NaN, 1.0f));
+  EXPECT_FALSE(ReduceFCmp<insane::FCmp_one>(NaN, 1.0f));
+  EXPECT_TRUE(ReduceFCmp<insane::FCmp_une>(NaN, 1.0f));
+  EXPECT_TRUE(ReduceFCmp<insane::FCmp_ole>(1.0f, 1.0f));
+
+  // Vector comparisons hold if they hold on every lane
+  insane::v8float Left = {0, 1, 2, 3, 4, 5, 6, 7};
+  insane::v8float Right = Left + 1;
+  EXPECT_TRUE(ReduceFCmp<insane::FCmp_olt>(Left, Right));
+  Right[7] = NaN;
+  EXPECT_FALSE(ReduceFCmp<insane::FCmp_olt>(Left, Right));
+  EXPECT_TRUE(ReduceFCmp<insane::FCmp_ult>(Left, Right));
+
+  // The shadows agree with the native comparison, so no warning is emitted
+  ShadowLanes<8> LeftShadows(Left), RightShadows(Right);
+
+  insane::InsaneRuntime<insane::MetaFloat<float, 8>> Backend;
+  EXPECT_FALSE(Backend.CheckFCmp<insane::FCmp_ole>(
+      Left, LeftShadows.opaque(), Right, RightShadows.opaque(), false));
+  EXPECT_TRUE(Backend.CheckFCmp(insane::FCmp_ule, Left, LeftShadows.opaque(),
+                                Right, RightShadows.opaque(), true));
+}
+
+TEST(MCASync, ReportPolicy) {
+  ShadowLanes<1> Shadow(1.0f);
+  Shadow[0].val[1] = 1.001f;
+
+  // Exits on error by default, a count only check just fails
+  insane::InsaneRuntime<insane::MetaFloat<float, 1>> Backend;
+  EXPECT_TRUE(Backend.Check<insane::Report_CountOnly>(1.0f, Shadow.opaque()));
+
+  insane::RuntimeFlags Flags;
+  Flags.setStackRecording(false);
+  unsigned Policy = insane::ReportPolicyFor(Flags);
+  EXPECT_EQ(Policy, insane::Report_Warnings | insane::Report_ExitOnError);
+
+  unsigned Selected = insane::Report_FromFlags;
+  insane::WithReportPolicy(Policy, [&](auto Specialization) {
+    Selected = decltype(Specialization)::value;
+  });
+  EXPECT_EQ(Selected, Policy);
+}
@@ -0,0 +1,76 @@
+/**
+ * @file recorder_benchmark.cpp
+ * @brief Contention of the warning recorder with the number of threads
+ * @version 1.0
+ *
+ *
+ */
+
+#include "Context.hpp"
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <thread>
+#include <vector>
+
+using namespace insane;
+
+constexpr size_t N_RECORDS = 1 << 20;
+
+// The recorder before per-thread shards, every record takes the same lock.
+// Stack ids are found as by the sharded recorder, only the counting differs
+class LockedRecorder : public WarningRecorder {
+public:
+  void print(std::string const &BackendName, std::ostream &out) {}
+
+private:
+  void RecordImpl() {
+    uint32_t SId = StacktraceRecorder::CurrentStackId();
+    std::scoped_lock<std::mutex> lock(Mutex);
+    Map[SId]++;
+  }
+
+  std::unordered_map<uint32_t, int> Map;
+  std::mutex Mutex;
+};
+
+// Total time for every thread to record N_RECORDS warnings
+double MeasureMs(WarningRecorder &Recorder, size_t NThreads) {
+  auto Start = std::chrono::steady_clock::now();
+  std::vector<std::thread> Threads;
+  for (size_t T = 0; T < NThreads; T++)
+    Threads.emplace_back([&Recorder] {
+      for (size_t I = 0; I < N_RECORDS; I++)
+        Recorder.Record();
+    });
+  for (auto &Thread : Threads)
+    Thread.join();
+  auto End = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(End - Start).count();
+}
+
+// Usage: recorder_benchmark.o [max threads]
+int main(int argc, char **argv) {
+  auto &Context = InsaneContext::getInstance();
+  Context.Init();
+  // No limit, the recorder must not exit
+  Context.Flags().setWarningLimit(0);
+  Context.Flags().setPrintStatsOnExit(false);
+
+  size_t MaxThreads = argc > 1 ? std::stoul(argv[1])
+                               : std::thread::hardware_concurrency();
+  std::cout << "threads\tsharded (ms)\tlocked (ms)\tsharded "
+               "ns/record/thread\tlocked ns/record/thread\n";
+  for (size_t NThreads = 1; NThreads <= MaxThreads; NThreads *= 2) {
+    StacktraceRecorder Sharded;
+    LockedRecorder Locked;
+    double ShardedMs = MeasureMs(Sharded, NThreads);
+    double LockedMs = MeasureMs(Locked, NThreads);
+    std::cout << NThreads << "\t" << ShardedMs << "\t" << LockedMs << "\t"
+              << ShardedMs * 1e6 / N_RECORDS << "\t"
+              << LockedMs * 1e6 / N_RECORDS << "\n";
+  }
+  return 0;
+}
@@ -0,0 +1,41 @@
+#include "AddressFilter.hpp"
+#include "Flags.hpp"
+#include <gtest/gtest.h>
+
+// Kept as symbols of the test program, for the address filters
+extern "C" __attribute__((noinline)) void *FilteredSite() {
+  return reinterpret_cast<void *>(&FilteredSite);
+}
+
+extern "C" __attribute__((noinline)) void *OtherSite() {
+  return reinterpret_cast<void *>(&OtherSite);
+}
+
+class AddressFilter : public testing::Test {
+protected:
+  char *Site = static_cast<char *>(FilteredSite()) + 1;
+  char *Other = static_cast<char *>(OtherSite()) + 1;
+
+  // Nothing is skipped without ranges
+  void TearDown() override { insane::SkippedRangeCount = 0; }
+};
+
+TEST_F(AddressFilter, Skip) {
+  EXPECT_FALSE(insane::SkippedSite(Site));
+
+  insane::RuntimeFlags Flags;
+  Flags.LoadFromString("skip=Filtered*");
+  ASSERT_EQ(Flags.getSkip().size(), 1u);
+  insane::ConfigureAddressFilter(Flags);
+  EXPECT_TRUE(insane::SkippedSite(Site));
+  EXPECT_FALSE(insane::SkippedSite(Other));
+}
+
+// Everything but the check_only functions is skipped
+TEST_F(AddressFilter, CheckOnly) {
+  insane::RuntimeFlags CheckOnly;
+  CheckOnly.LoadFromString("check_only = FilteredSite, verbose=false");
+  insane::ConfigureAddressFilter(CheckOnly);
+  EXPECT_FALSE(insane::SkippedSite(Site));
+  EXPECT_TRUE(insane::SkippedSite(Other));
+}
@@ -0,0 +1,148 @@
+#include "Flags.hpp"
+#include "Trace.hpp"
+#include "Utils.hpp"
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+class Trace : public testing::Test {
+protected:
+  std::filesystem::path Prefix =
+      std::filesystem::temp_directory_path() / "insane_trace_test";
+
+  void SetUp() override {
+    insane::RuntimeFlags Flags;
+    Flags.setTrace(true);
+    Flags.setTracePrefix(Prefix.string());
+    Flags.setTraceSegmentSize(1);
+    insane::ConfigureTrace(Flags);
+    ASSERT_TRUE(insane::TraceEnabled);
+  }
+
+  // The main thread owns the first segment of the process
+  std::string Close() {
+    insane::CloseThreadTrace();
+    insane::TraceEnabled = false;
+    return Prefix.string() + "." + std::to_string(getpid()) + ".0.0.trace";
+  }
+};
+
+TEST_F(Trace, Records) {
+  // A scalar binary operation, then a range larger than a record
+  float Shadows[4096];
+  std::vector<double> Range(3000, 0.5);
+  {
+    insane::TraceRecord Record(7, &Shadows[0]);
+    Record.Value(1.5f);
+    Record.Shadow(&Shadows[8]);
+    Record.Value(-2.0f);
+    Record.Shadow(&Shadows[4]);
+  }
+  insane::TraceShadowRange(9, &Shadows[1], Range.data(), &Shadows[16],
+                           Range.size());
+  std::string Path = Close();
+
+  std::string Error;
+  insane::TraceReader Reader(Path, Error);
+  ASSERT_TRUE(Reader.valid()) << Error;
+  EXPECT_EQ(Reader.header().Records, 4u);
+  EXPECT_EQ(Reader.header().ShadowScale, insane::utils::GetNSanShadowScale());
+
+  uint16_t Entry;
+  uintptr_t Callsite;
+  insane::TracePayloadReader Payload;
+  float Value;
+  ASSERT_TRUE(Reader.Next(Entry, Callsite, Payload));
+  EXPECT_EQ(Entry, 7);
+  EXPECT_EQ(Callsite, reinterpret_cast<uintptr_t>(&Shadows[0]));
+  Payload.Value(Value);
+  EXPECT_EQ(Value, 1.5f);
+  EXPECT_EQ(Payload.Shadow(), reinterpret_cast<uintptr_t>(&Shadows[8]));
+  Payload.Value(Value);
+  EXPECT_EQ(Value, -2.0f);
+  EXPECT_EQ(Payload.Shadow(), reinterpret_cast<uintptr_t>(&Shadows[4]));
+
+  size_t Values = 0;
+  while (Reader.Next(Entry, Callsite, Payload)) {
+    EXPECT_EQ(Entry, 9);
+    auto Stride = sizeof(double) * Reader.header().ShadowScale;
+    EXPECT_EQ(Payload.Shadow(),
+              reinterpret_cast<uintptr_t>(&Shadows[16]) + Values * Stride);
+    size_t Count = Payload.Size();
+    std::vector<double> Read(Count);
+    Payload.Values(Read.data(), Count);
+    for (double Value : Read)
+      ASSERT_EQ(Value, 0.5);
+    Values += Count;
+  }
+  EXPECT_EQ(Values, Range.size());
+  std::filesystem::remove(Path);
+}
+
+// Values are XORed with the previous ones of their callsite
+TEST_F(Trace, ValueDeltas) {
+  using Vector = double __attribute__((vector_size(32)));
+  char Callsites[2];
+  long double Wide[] = {1.0L / 3, -1.0L / 3};
+  Vector Lanes[] = {{1, 2, 3, 4}, {1, 2, 3, 5}};
+  for (int I = 0; I < 2; I++) {
+    {
+      insane::TraceRecord Record(1, &Callsites[0]);
+      Record.Value(0.1);
+      Record.Value(Wide[I]);
+      Record.Value(Lanes[I]);
+    }
+    // Interleaved, with its own previous values
+    insane::TraceRecord Record(2, &Callsites[1]);
+    Record.Value(I + 0.25f);
+  }
+  std::string Path = Close();
+
+  std::string Error;
+  insane::TraceReader Reader(Path, Error);
+  ASSERT_TRUE(Reader.valid()) << Error;
+  uint16_t Entry;
+  uintptr_t Callsite;
+  insane::TracePayloadReader Payload;
+  for (int I = 0; I < 2; I++) {
+    ASSERT_TRUE(Reader.Next(Entry, Callsite, Payload));
+    EXPECT_EQ(Entry, 1);
+    double Value;
+    long double WideValue;
+    Vector LanesValue;
+    Payload.Value(Value);
+    Payload.Value(WideValue);
+    Payload.Value(LanesValue);
+    EXPECT_EQ(Value, 0.1);
+    EXPECT_EQ(WideValue, Wide[I]);
+    for (int Lane = 0; Lane < 4; Lane++)
+      EXPECT_EQ(LanesValue[Lane], Lanes[I][Lane]);
+
+    ASSERT_TRUE(Reader.Next(Entry, Callsite, Payload));
+    EXPECT_EQ(Entry, 2);
+    float Single;
+    Payload.Value(Single);
+    EXPECT_EQ(Single, I + 0.25f);
+  }
+  std::filesystem::remove(Path);
+}
+
+TEST_F(Trace, RepeatedValues) {
+  char Callsite;
+  for (int I = 0; I < 100; I++) {
+    insane::TraceRecord Record(1, &Callsite);
+    Record.Value(0.1);
+  }
+  std::string Path = Close();
+
+  // Past the first record, a header, a zero callsite delta and a zero XOR
+  std::string Error;
+  insane::TraceReader Reader(Path, Error);
+  ASSERT_TRUE(Reader.valid()) << Error;
+  size_t Repeated = sizeof(insane::TraceRecordHeader) + 2;
+  EXPECT_LE(Reader.header().Size,
+            sizeof(insane::TraceRecordHeader) + 20 + 99 * Repeated);
+  std::filesystem::remove(Path);
+}
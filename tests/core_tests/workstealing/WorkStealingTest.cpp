@@ -0,0 +1,43 @@
+#include "WorkStealing.hpp"
+#include <atomic>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <thread>
+
+TEST(WorkStealingPool, NestedTasks) {
+  insane::WorkStealingPool Pool(4);
+  std::atomic<size_t> Total{0};
+  // Uneven tasks, half of them submitting more work from the workers
+  for (size_t I = 0; I < 1000; I++)
+    Pool.Submit([&Pool, &Total, I] {
+      Total.fetch_add(I, std::memory_order_relaxed);
+      if (I % 2 == 0)
+        for (size_t J = 0; J < I % 16; J++)
+          Pool.Submit([&Total] { Total.fetch_add(1, std::memory_order_relaxed); });
+    });
+  Pool.Run();
+
+  size_t Expected = 0;
+  for (size_t I = 0; I < 1000; I++)
+    Expected += I + ((I % 2 == 0) ? I % 16 : 0);
+  EXPECT_EQ(Total.load(), Expected);
+}
+
+TEST(WorkStealingPool, Empty) {
+  insane::WorkStealingPool Pool(4);
+  Pool.Run();
+}
+
+// Idle workers wake up for the tasks submitted late by a long one
+TEST(WorkStealingPool, LateSubmit) {
+  insane::WorkStealingPool Pool(4);
+  std::atomic<size_t> Done{0};
+  Pool.Submit([&Pool, &Done] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    for (int I = 0; I < 8; I++)
+      Pool.Submit([&Done] { Done.fetch_add(1, std::memory_order_relaxed); });
+    Done.fetch_add(1, std::memory_order_relaxed);
+  });
+  Pool.Run();
+  EXPECT_EQ(Done.load(), 9u);
+}
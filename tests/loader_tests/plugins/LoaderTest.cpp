@@ -0,0 +1,69 @@
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <link.h>
+#include <string>
+#include <vector>
+
+// The plugins call back into nsan's runtime, which the test stands in for
+void __nsan_dump_stacktrace() {}
+
+uint32_t __nsan_save_stacktrace() { return 0; }
+
+void __nsan_print_stacktrace(uint32_t) {}
+
+size_t __nsan_get_shadowscale() {
+  return std::stoul(getenv("LOADER_TEST_SHADOW_SCALE"));
+}
+
+// Bound by the loader to the selected plugin
+extern "C" void __interflop_init();
+extern "C" void __insane_double_make_shadow(double, void *);
+extern "C" double __insane_double_fadd(double, void *, double, void *, void *);
+extern "C" int __insane_double_check(double, void *);
+
+namespace {
+
+int ListPlugin(dl_phdr_info *Info, size_t, void *Data) {
+  if (strstr(Info->dlpi_name, "-plugin.so") != nullptr)
+    static_cast<std::vector<std::string> *>(Data)->push_back(Info->dlpi_name);
+  return 0;
+}
+
+} // namespace
+
+// Entries may be called before the program calls __interflop_init, as by
+// static constructors. The checks then report as the default flags say, and
+// exit on the first failure. Runs before Arithmetic initializes the runtime
+TEST(Loader, CheckBeforeInit) {
+  alignas(64) char Shadow[64] = {};
+  __insane_double_make_shadow(0.1, Shadow);
+  EXPECT_EQ(__insane_double_check(0.1, Shadow), 0);
+
+  // The second MCASync sample, or the high half of a DoublePrec shadow
+  double Perturbed = 0.2;
+  std::memcpy(Shadow + sizeof(double), &Perturbed, sizeof(double));
+  EXPECT_EXIT(__insane_double_check(0.1, Shadow), testing::ExitedWithCode(1),
+              "");
+}
+
+// The expected plugin is set by ctest, see CMakeLists.txt
+TEST(Loader, SelectedPlugin) {
+  std::vector<std::string> Plugins;
+  dl_iterate_phdr(ListPlugin, &Plugins);
+  ASSERT_EQ(Plugins.size(), 1u);
+  std::string Expected =
+      std::string("libinterflop-") + getenv("LOADER_TEST_PLUGIN") + "-plugin.so";
+  EXPECT_NE(Plugins[0].find(Expected), std::string::npos) << Plugins[0];
+}
+
+TEST(Loader, Arithmetic) {
+  __interflop_init();
+  alignas(64) char Shadows[3][64] = {};
+  __insane_double_make_shadow(0.1, Shadows[0]);
+  __insane_double_make_shadow(0.2, Shadows[1]);
+  double Res = __insane_double_fadd(0.1, Shadows[0], 0.2, Shadows[1], Shadows[2]);
+  EXPECT_EQ(Res, 0.1 + 0.2);
+  EXPECT_EQ(__insane_double_check(Res, Shadows[2]), 0);
+}
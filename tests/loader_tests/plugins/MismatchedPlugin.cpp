@@ -0,0 +1,9 @@
+#include "Plugin.hpp"
+
+// A plugin generated from another interface, the loader must refuse it
+extern "C" insane::PluginTable const *__insane_plugin_table() {
+  static void *const Entries[1] = {nullptr};
+  static insane::PluginTable const Table = {insane::PluginABIVersion, 1, 0,
+                                            Entries};
+  return &Table;
+}
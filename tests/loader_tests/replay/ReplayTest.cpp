@@ -0,0 +1,104 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// The plugins call back into nsan's runtime, which the test stands in for
+void __nsan_dump_stacktrace() {}
+
+uint32_t __nsan_save_stacktrace() { return 0; }
+
+void __nsan_print_stacktrace(uint32_t) {}
+
+// Of the DoublePrec backend, selected by ctest
+size_t __nsan_get_shadowscale() { return 2; }
+
+// Bound by the loader to the selected plugin
+extern "C" void __interflop_init();
+extern "C" void __insane_float_make_shadow(float, void *);
+extern "C" float __insane_float_fadd(float, void *, float, void *, void *);
+extern "C" float __insane_float_fsub(float, void *, float, void *, void *);
+extern "C" int __insane_float_check(float, void *);
+
+namespace {
+
+constexpr int Iterations = 5;
+constexpr unsigned Samples = 3;
+
+// Two checks, the second one of a cancellation absorbing 1 in float
+void TracedProgram() {
+  alignas(64) char Half[64], Large[64], One[64], Sum[64], Difference[64];
+  for (int I = 0; I < Iterations; I++) {
+    __insane_float_make_shadow(0.5f, Half);
+    __insane_float_check(0.5f, Half);
+
+    __insane_float_make_shadow(1e8f, Large);
+    __insane_float_make_shadow(1.0f, One);
+    float Value = __insane_float_fadd(1e8f, Large, 1.0f, One, Sum);
+    Value = __insane_float_fsub(Value, Sum, 1e8f, Large, Difference);
+    __insane_float_check(Value, Difference);
+  }
+}
+
+struct CallsiteRow {
+  unsigned long Checks;
+  unsigned long Failures;
+  long FailedSamples;
+};
+
+} // namespace
+
+TEST(Replay, CallsiteCounts) {
+  auto Directory = std::filesystem::temp_directory_path();
+  std::string Prefix = (Directory / "insane_replay_test").string();
+  std::string Options = getenv("INSANE_OPTIONS");
+  Options += " trace=true trace_prefix=" + Prefix;
+  setenv("INSANE_OPTIONS", Options.c_str(), 1);
+  __interflop_init();
+
+  // The segment is closed when the thread exits
+  std::thread(TracedProgram).join();
+
+  std::string Segment = "insane_replay_test." + std::to_string(getpid()) + ".";
+  std::vector<std::string> Segments;
+  for (auto const &Entry : std::filesystem::directory_iterator(Directory))
+    if (Entry.path().filename().string().rfind(Segment, 0) == 0)
+      Segments.push_back(Entry.path().string());
+  ASSERT_EQ(Segments.size(), 1u);
+
+  std::string Command = std::string(getenv("REPLAY_TEST_REPLAY")) +
+                        " --backend doubleprec --jobs 2 --samples " +
+                        std::to_string(Samples) + " " + Segments[0] +
+                        " 2>/dev/null";
+  FILE *Replay = popen(Command.c_str(), "r");
+  ASSERT_NE(Replay, nullptr);
+  std::vector<CallsiteRow> Rows;
+  char Line[256];
+  while (fgets(Line, sizeof(Line), Replay)) {
+    CallsiteRow Row;
+    uintptr_t Callsite;
+    unsigned Total;
+    if (sscanf(Line, "0x%lx %lu %lu %ld / %u", &Callsite, &Row.Checks,
+               &Row.Failures, &Row.FailedSamples, &Total) == 5) {
+      EXPECT_EQ(Total, Samples);
+      Rows.push_back(Row);
+    }
+  }
+  EXPECT_EQ(pclose(Replay), 0);
+  for (std::string const &Path : Segments)
+    std::filesystem::remove(Path);
+
+  // Callsites failing in most samples first
+  ASSERT_EQ(Rows.size(), 2u);
+  EXPECT_EQ(Rows[0].Checks, Iterations * Samples);
+  EXPECT_EQ(Rows[0].Failures, Iterations * Samples);
+  EXPECT_EQ(Rows[0].FailedSamples, Samples);
+  EXPECT_EQ(Rows[1].Checks, Iterations * Samples);
+  EXPECT_EQ(Rows[1].Failures, 0u);
+  EXPECT_EQ(Rows[1].FailedSamples, 0);
+}